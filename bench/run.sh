@@ -0,0 +1,53 @@
+#!/usr/bin/env bash
+# Runs every bench/*.pud with both interpreters and prints one JSON object
+# per benchmark and mode with median wall time, allocations and peak RSS.
+#
+# usage: bench/run.sh [runs] [pudel binary]
+
+set -euo pipefail
+
+runs=${1:-5}
+bench_dir=$(cd "$(dirname "$0")" && pwd)
+pudel=$(cd "$(dirname "${2:-$bench_dir/../pudel}")" && pwd)/$(basename "${2:-pudel}")
+
+# value of key from a "stats: key=value ..." line
+stat() {
+    sed -n "s/.*[ ]$1=\([^ ]*\).*/\1/p" <<< "$2"
+}
+
+median() {
+    sort -g | awk '{ values[NR] = $1 } END { if (NR % 2) print values[(NR + 1) / 2]; else printf "%.3f\n", (values[NR / 2] + values[NR / 2 + 1]) / 2 }'
+}
+
+# imports in benchmarks are relative to bench/
+cd "$bench_dir"
+
+for file in *.pud; do
+    name=${file%.pud}
+    for mode in tree vm; do
+        flags=(--stats)
+        if [ "$mode" = vm ]; then
+            flags+=(--vm)
+        fi
+
+        times=()
+        rss=()
+        line=
+        for ((run = 0; run < runs; ++run)); do
+            if ! line=$("$pudel" "${flags[@]}" "$file" 2>&1 >/dev/null | grep '^stats:'); then
+                echo "{\"benchmark\":\"$name\",\"mode\":\"$mode\",\"error\":\"failed\"}"
+                continue 2
+            fi
+            times+=("$(stat wall_ms "$line")")
+            rss+=("$(stat peak_rss_kb "$line")")
+        done
+
+        printf '{"benchmark":"%s","mode":"%s","runs":%d,"median_ms":%s,"allocations":%s,"allocated_bytes":%s,"collections":%s,"peak_rss_kb":%s}\n' \
+            "$name" "$mode" "$runs" \
+            "$(printf '%s\n' "${times[@]}" | median)" \
+            "$(stat allocations "$line")" \
+            "$(stat allocated_bytes "$line")" \
+            "$(stat collections "$line")" \
+            "$(printf '%s\n' "${rss[@]}" | median)"
+    done
+done
@@ -0,0 +1,26 @@
+#pragma once
+#include <stddef.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 8
+
+#define ARENA_GROW_ARRAY(arena, type, pointer, old_count, new_count) \
+    (type*)arena_grow(arena, pointer, sizeof(type) * (old_count), sizeof(type) * (new_count))
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t capacity;
+    size_t used;
+    char data[];
+} ArenaBlock;
+
+// bump allocator, memory is zeroed and only released all at once
+typedef struct {
+    ArenaBlock* blocks;  // newest first
+    void* last;          // most recent allocation, which can grow in place
+} Arena;
+
+void arena_init(Arena* arena);
+void* arena_alloc(Arena* arena, size_t size);
+void* arena_grow(Arena* arena, void* pointer, size_t old_size, size_t new_size);
+void arena_free(Arena* arena);
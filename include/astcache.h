@@ -0,0 +1,13 @@
+#pragma once
+#include "arena.h"
+#include "parser.h"
+
+#define AST_CACHE_SUFFIX "c"      // cache of program.pud is program.pudc
+#define AST_CACHE_MAGIC "PUDC"
+#define AST_CACHE_VERSION 6       // must be increased whenever AST nodes or their encoding change
+
+void astcache_set_enabled(bool enabled);
+
+// Parses and resolves source file. Resolved tree is cached next to the file
+// and loaded from there instead while size, mtime and hash of source match.
+bool astcache_parse_file(const char* path, Arena* arena, ASTNode** output);
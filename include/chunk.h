@@ -0,0 +1,75 @@
+#pragma once
+#include <stdint.h>
+#include "environment.h"
+#include "value.h"
+
+typedef enum {
+    OP_CONSTANT,       // u16 constant index
+    OP_NULL,
+    OP_TRUE,
+    OP_FALSE,
+    OP_POP,
+    OP_DUP2,
+
+    OP_GET_LOCAL,      // u8 slot
+    OP_SET_LOCAL,      // u8 slot
+    OP_GET_GLOBAL,     // u16 name constant, u16 inline cache
+    OP_SET_GLOBAL,     // u16 name constant, u16 inline cache
+    OP_DEFINE_GLOBAL,  // u16 name constant
+    OP_GET_PROPERTY,   // u16 name constant, u16 inline cache
+    OP_GET_INDEX,
+    OP_SET_INDEX,
+
+    OP_EQUAL,
+    OP_NOT_EQUAL,
+    OP_GREATER,
+    OP_GREATER_EQUAL,
+    OP_LESS,
+    OP_LESS_EQUAL,
+    OP_ADD,
+    OP_SUBTRACT,
+    OP_MULTIPLY,
+    OP_DIVIDE,
+    OP_MODULO,
+    OP_COMPOUND,       // u8 assignment operator token
+    OP_NOT,
+    OP_NEGATE,
+
+    OP_JUMP,           // u16 forward offset
+    OP_JUMP_IF_FALSE,  // u16 forward offset, condition stays on stack
+    OP_LOOP,           // u16 backward offset
+    OP_RANGE,          // u8 argument count, skips following OP_CALL and OP_ITERATOR when calling native range
+    OP_ITERATOR,       // replaces iterated list or map with its iteration state
+    OP_FOR_IN,         // u8 slot of iteration state, u16 forward offset taken when iteration ends
+
+    OP_CALL,           // u8 argument count
+    OP_TAIL_CALL,      // u8 argument count, callee function replaces current frame, natives are called as by OP_CALL
+    OP_RETURN,
+    OP_LIST,           // u16 initial capacity
+    OP_LIST_APPEND,
+    OP_MAP,            // u16 initial capacity
+    OP_MAP_INSERT,
+    OP_FUNCTION,       // u16 function constant
+    OP_IMPORT,         // u16 path constant, u16 name constant
+} OpCode;
+
+typedef struct Chunk {
+    uint8_t* code;
+    int* lines;
+    int count;
+    int capacity;
+
+    Value* constants;
+    int constant_count;
+    int constant_capacity;
+
+    EnvCache* caches;  // of global and module member lookups
+    int cache_count;
+    int cache_capacity;
+} Chunk;
+
+Chunk* chunk_new();
+void chunk_free(Chunk* chunk);
+void chunk_write(Chunk* chunk, uint8_t byte, int line);
+int chunk_add_constant(Chunk* chunk, Value value);
+int chunk_add_cache(Chunk* chunk);
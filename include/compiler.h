@@ -0,0 +1,5 @@
+#pragma once
+#include "parser.h"
+#include "value.h"
+
+Function* compiler_compile(ASTNode* root);
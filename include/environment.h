@@ -2,13 +2,34 @@
 #include "hashmap.h"
 
 typedef struct Environment {
+    Obj obj;
     struct Environment* enclosing;
     HashMap map;
+    uint32_t version;  // changes whenever a name is defined, stamps are never reused by other environments
 } Environment;
 
+// Inline cache of a lookup site. Variable found there is reused while neither the environment
+// of the lookup nor the one holding the variable gets a new name, which could shadow the
+// variable or move it by growing the table.
+typedef struct {
+    Environment* env;     // NULL until first lookup
+    Environment* holder;  // env or its enclosing environment
+    uint32_t env_version;
+    uint32_t holder_version;
+    Value* ref;
+} EnvCache;
+
 Environment* env_new();
 Environment* env_new_with_enclosing(Environment* env);
-void env_free(Environment* env);
+Environment* env_new_sized(Environment* env, int count);  // enclosed by env, holds count names without growing
 
 bool env_define(Environment* env, String* name, Value value);
 Value* env_get_ref(Environment* env, String* name);
+Value* env_get_and_cache(Environment* env, String* name, EnvCache* cache);  // used by env_get_cached()
+
+static inline Value* env_get_cached(Environment* env, String* name, EnvCache* cache) {
+    if (cache->env == env && cache->env_version == env->version && cache->holder_version == cache->holder->version) {
+        return cache->ref;
+    }
+    return env_get_and_cache(env, name, cache);
+}
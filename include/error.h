@@ -0,0 +1,5 @@
+#pragma once
+
+extern int current_line;
+
+void runtime_error(const char* format, ...);
@@ -1,9 +1,10 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 
 struct String;
 
 typedef uint32_t Hash;
 
-Hash hash_cstring(const char* cstring, int length);
+Hash hash_cstring(const char* cstring, size_t length);
 Hash hash_string(struct String* string);
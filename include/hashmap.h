@@ -1,7 +1,7 @@
 #pragma once
 #include "value.h"
 
-#define HASHMAP_INITIAL_CAPACITY 16
+#define HASHMAP_INITIAL_CAPACITY 16  // capacity is always power of two, so index is masked hash
 #define HASHMAP_LOAD_FACTOR 0.75
 
 typedef struct {
@@ -16,6 +16,7 @@ typedef struct {
 } HashMap;
 
 HashMap hashmap_create();
+HashMap hashmap_create_sized(int count);  // holds count keys without growing
 void hashmap_free(HashMap* map);
 bool hashmap_put(HashMap* map, String* key, Value value);
 Value* hashmap_get_ref(HashMap* map, String* key);
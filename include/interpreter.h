@@ -3,3 +3,4 @@
 #include "value.h"
 
 Value interpreter_interpret(ASTNode* root);
+void interpreter_mark_roots();
@@ -1,3 +1,12 @@
 #pragma once
+#include <stddef.h>
 
-char* file_read(const char* file_path);
+// contents of file mapped read-only into memory, not NUL-terminated
+typedef struct {
+    const char* data;
+    size_t length;
+} MappedFile;
+
+MappedFile file_map(const char* file_path);
+void file_unmap(MappedFile* file);
+char* file_canonical_path(const char* file_path);
@@ -1,4 +1,5 @@
 #pragma once
+#include <stddef.h>
 
 typedef enum TokenType {
     TOKEN_EOF,             // EOF
@@ -49,6 +50,7 @@ typedef enum TokenType {
     TOKEN_FUNC,            // func
     TOKEN_IF,              // if
     TOKEN_IMPORT,          // import
+    TOKEN_IN,              // in
     TOKEN_NULL,            // null
     TOKEN_OR,              // or
     TOKEN_RETURN,          // return
@@ -66,7 +68,7 @@ typedef struct Token {
     int length;
 } Token;
 
-void lexer_init(const char* source);
+void lexer_init(const char* source, size_t length);
 Token lexer_next_token();
 
 const char* token_as_cstr(TokenType type);
@@ -0,0 +1,21 @@
+#pragma once
+#include "value.h"
+
+#define MAP_INITIAL_CAPACITY 8  // capacity is always power of two, so index is masked hash
+#define MAP_LOAD_FACTOR 0.75    // counts tombstones too, they lengthen probing like keys
+
+Map* map_new(int capacity);
+
+// Checks that value can be a key and returns it as stored in maps, which for strings
+// is the interned one, so keys are compared by pointer. Key must be reachable by GC.
+Value map_key(Value key);
+
+// keys must be returned by map_key()
+Value* map_get_ref(Map* map, Value key);
+bool map_set(Map* map, Value key, Value value);  // returns true if key was already present
+bool map_remove(Map* map, Value key);            // returns true if key was present
+
+// index of first entry holding a key at index or after it, -1 if there is none
+int map_next(Map* map, int index);
+
+bool maps_equal(Map* a, Map* b);
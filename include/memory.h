@@ -1,4 +1,7 @@
 #pragma once
+#include <stddef.h>
+#include "hashmap.h"
+#include "value.h"
 
 #define GROW_CAPACITY(capacity) \
     ((capacity) < 4 ? 4 : (capacity) * 2)
@@ -6,4 +9,30 @@
 #define GROW_ARRAY(type, pointer, new_count) \
     (type*)reallocate(pointer, sizeof(type) * (new_count))
 
+#define GC_INITIAL_THRESHOLD (1024 * 1024)  // bytes allocated before first collection
+#define GC_DEFAULT_GROWTH 2.0               // next collection happens when heap grows by this factor
+
+// totals since start of the program
+typedef struct {
+    size_t allocations;
+    size_t allocated_bytes;
+    size_t collections;
+} GCStats;
+
 void* reallocate(void* pointer, int new_size);
+
+Obj* gc_allocate(size_t size, ObjType type);
+void gc_track(long bytes);  // accounts memory owned by object, but allocated after it
+void gc_set_growth(double factor);
+
+// objects allocated between begin and end (and strings interned there) are never collected
+void gc_pin_begin();
+void gc_pin_end();
+bool gc_pinning();
+
+void gc_mark_value(Value value);
+void gc_mark_object(Obj* object);
+void gc_mark_hashmap(HashMap* map);
+void gc_collect();
+void gc_free_all();
+GCStats gc_stats();
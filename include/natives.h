@@ -0,0 +1,17 @@
+#pragma once
+#include <stdint.h>
+#include "environment.h"
+
+void natives_define(Environment* env);
+
+void natives_arity_error(Native* native, int argc);
+
+// natives rely on their declared arity, so every call site checks it before the call
+static inline void natives_check_arity(Native* native, int argc) {
+    if (argc < native->min_arity || argc > native->max_arity) natives_arity_error(native, argc);
+}
+
+// loops iterate range(end), range(start, end) and range(start, end, step) without creating the list;
+// arity must be checked by caller, returns number of iterated integers
+int64_t natives_range_arguments(int argc, Value* argv, int64_t* start, int64_t* step);
+bool natives_is_range(Value callee);
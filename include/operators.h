@@ -0,0 +1,61 @@
+#pragma once
+#include "lexer.h"
+#include "value.h"
+
+bool is_truthy(Value value);
+
+Value operator_unary(TokenType op, Value value);
+Value operator_binary(TokenType op, Value left, Value right);
+Value operator_compound(TokenType op, Value target, Value value);
+
+// Fast paths of operator_binary() and operator_compound() for two ints or two floats.
+// Return false when the generic operator has to run, e.g. to report division by zero or overflow.
+static inline bool operator_ints(TokenType op, int64_t a, int64_t b, Value* result) {
+    int64_t value;
+    switch (op) {
+        case TOKEN_PLUS:
+        case TOKEN_PLUS_EQUAL:     if (__builtin_add_overflow(a, b, &value)) return false; break;
+        case TOKEN_MINUS:
+        case TOKEN_MINUS_EQUAL:    if (__builtin_sub_overflow(a, b, &value)) return false; break;
+        case TOKEN_ASTERISK:
+        case TOKEN_ASTERISK_EQUAL: if (__builtin_mul_overflow(a, b, &value)) return false; break;
+        case TOKEN_SLASH:
+        case TOKEN_SLASH_EQUAL:    if (b == 0 || (b == -1 && a == INT_VALUE_MIN)) return false; value = a / b; break;
+        case TOKEN_PERCENT:
+        case TOKEN_PERCENT_EQUAL:  if (b == 0) return false; value = b == -1 ? 0 : a % b; break;
+        case TOKEN_EQUAL_EQUAL:    *result = BOOL_VALUE(a == b); return true;
+        case TOKEN_NOT_EQUAL:      *result = BOOL_VALUE(a != b); return true;
+        case TOKEN_GREATER:        *result = BOOL_VALUE(a > b); return true;
+        case TOKEN_GREATER_EQUAL:  *result = BOOL_VALUE(a >= b); return true;
+        case TOKEN_LESS:           *result = BOOL_VALUE(a < b); return true;
+        case TOKEN_LESS_EQUAL:     *result = BOOL_VALUE(a <= b); return true;
+        default:                   return false;
+    }
+    if (!int_fits(value)) return false;
+    *result = INT_VALUE(value);
+    return true;
+}
+
+static inline bool operator_floats(TokenType op, double a, double b, Value* result) {
+    switch (op) {
+        case TOKEN_PLUS:
+        case TOKEN_PLUS_EQUAL:     *result = FLOAT_VALUE(a + b); return true;
+        case TOKEN_MINUS:
+        case TOKEN_MINUS_EQUAL:    *result = FLOAT_VALUE(a - b); return true;
+        case TOKEN_ASTERISK:
+        case TOKEN_ASTERISK_EQUAL: *result = FLOAT_VALUE(a * b); return true;
+        case TOKEN_SLASH:
+        case TOKEN_SLASH_EQUAL:    if (b == 0.0) return false; *result = FLOAT_VALUE(a / b); return true;
+        case TOKEN_EQUAL_EQUAL:    *result = BOOL_VALUE(a == b); return true;
+        case TOKEN_NOT_EQUAL:      *result = BOOL_VALUE(a != b); return true;
+        case TOKEN_GREATER:        *result = BOOL_VALUE(a > b); return true;
+        case TOKEN_GREATER_EQUAL:  *result = BOOL_VALUE(a >= b); return true;
+        case TOKEN_LESS:           *result = BOOL_VALUE(a < b); return true;
+        case TOKEN_LESS_EQUAL:     *result = BOOL_VALUE(a <= b); return true;
+        default:                   return false;  // modulo of floats is an error
+    }
+}
+
+// list element or map value, object and index must be reachable by GC
+Value operator_subscript_get(Value object, Value index);
+void operator_subscript_set(Value object, Value index, Value value);
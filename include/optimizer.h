@@ -0,0 +1,8 @@
+#pragma once
+#include "arena.h"
+#include "parser.h"
+
+// Folds operations on literals into literals and removes branches that can never run.
+// Runs on resolved tree, operations that would fail at runtime are left to fail there.
+// New nodes are allocated in given arena, the one holding the tree.
+void optimizer_fold_constants(ASTNode* root, Arena* arena);
@@ -1,4 +1,6 @@
 #pragma once
+#include "arena.h"
+#include "environment.h"
 #include "lexer.h"
 #include "value.h"
 
@@ -12,6 +14,7 @@ typedef enum {
     AST_NODE_IF_STMT,
     AST_NODE_WHILE_STMT,
     AST_NODE_FOR_STMT,
+    AST_NODE_FOR_IN_STMT,
     AST_NODE_RETURN_STMT,
     AST_NODE_BREAK,
     AST_NODE_CONTINUE,
@@ -26,9 +29,18 @@ typedef enum {
     AST_NODE_SUBSCRIPTION,
     AST_NODE_LITERAL,
     AST_NODE_LIST,
+    AST_NODE_MAP,
     AST_NODE_VAR,
 } ASTNodeType;
 
+// operand types seen by tree-walk interpreter, which specialises binary and assignment nodes for them
+typedef enum {
+    QUICK_NONE,     // not evaluated yet
+    QUICK_INTS,     // both operands were ints
+    QUICK_FLOATS,   // both operands were floats
+    QUICK_GENERIC,  // other types were seen, generic operators handle them
+} Quickening;
+
 typedef struct ASTNode {
     ASTNodeType type;
     int line;
@@ -40,6 +52,7 @@ typedef struct {
     ASTNode** statements;
     int count;
     int capacity;
+    int local_count;  // number of variables declared directly in block, or globals of program, set by resolver
 } ASTNodeBlock;
 
 typedef struct {
@@ -47,6 +60,7 @@ typedef struct {
 
     String* path;
     String* name;
+    int slot;  // relative to call frame, -1 for globals, set by resolver
 } ASTNodeImport;
 
 typedef struct {
@@ -63,6 +77,7 @@ typedef struct {
 
     String* name;
     ASTNode* initializer;
+    int slot;  // relative to call frame, -1 for globals, set by resolver
 } ASTNodeVarDecl;
 
 typedef struct {
@@ -93,14 +108,25 @@ typedef struct {
     ASTNode* condition;
     ASTNode* increment;
     ASTNode* body;
+    int local_count;  // number of variables declared in initializer, set by resolver
 } ASTNodeForStmt;
 
+typedef struct {
+    ASTNode base;
+
+    String* name;
+    ASTNode* iterable;
+    ASTNode* body;
+    int slot;  // of loop variable, iterated list or map is kept in slot before it, set by resolver
+} ASTNodeForInStmt;
+
 typedef struct {
     ASTNode base;
 
     TokenType op;
     ASTNode* target;
     ASTNode* value;
+    Quickening quickening;  // of compound assignment, set by interpreter
 } ASTNodeAssignment;
 
 typedef struct {
@@ -109,6 +135,7 @@ typedef struct {
     TokenType op;
     ASTNode* left;
     ASTNode* right;
+    Quickening quickening;  // set by interpreter, unused by logical nodes
 } ASTNodeBinary;
 
 typedef struct {
@@ -132,6 +159,7 @@ typedef struct {
 
     ASTNode* object;
     String* name;
+    EnvCache cache;  // of member of module, set by interpreter
 } ASTNodeGet;
 
 typedef struct {
@@ -151,6 +179,8 @@ typedef struct {
     ASTNode base;
 
     String* name;
+    int slot;        // relative to call frame, -1 for globals, set by resolver
+    EnvCache cache;  // of global, set by interpreter
 } ASTNodeVar;
 
 typedef struct {
@@ -161,5 +191,14 @@ typedef struct {
     int capacity;
 } ASTNodeList;
 
-bool parser_parse(const char* source, ASTNode** output);
-void parser_free_ast(ASTNode* root);
+typedef struct {
+    ASTNode base;
+
+    ASTNode** keys;
+    ASTNode** values;
+    int count;
+    int capacity;
+} ASTNodeMap;
+
+// nodes are allocated in given arena, tree is freed by freeing the arena
+bool parser_parse(const char* source, size_t length, Arena* arena, ASTNode** output);
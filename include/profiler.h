@@ -0,0 +1,27 @@
+#pragma once
+#include <signal.h>
+#include <stdbool.h>
+#include "value.h"
+
+#define PROFILER_INTERVAL_US 1000   // CPU time between timer ticks
+#define PROFILER_STACK_MAX 4096     // deeper calls are attributed to the deepest recorded one
+
+extern volatile sig_atomic_t profiler_ticks;  // timer ticks since last sample
+extern bool profiler_running;
+
+// timer only counts ticks, samples are taken by interpreters at statements, calls and loops
+#define PROFILER_POLL() \
+    do { if (profiler_ticks) profiler_sample(); } while (false)
+#define PROFILER_ENTER(function) \
+    do { if (profiler_running) profiler_enter(function); } while (false)
+#define PROFILER_LEAVE() \
+    do { if (profiler_running) profiler_leave(); } while (false)
+
+// report is written to output_path and folded stacks to output_path.folded on stop or exit
+void profiler_start(const char* output_path);
+void profiler_stop();
+
+void profiler_enter(Function* function);
+void profiler_leave();
+void profiler_sample();
+void profiler_mark_roots();
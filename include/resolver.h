@@ -0,0 +1,4 @@
+#pragma once
+#include "parser.h"
+
+bool resolver_resolve(ASTNode* root);
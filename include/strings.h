@@ -3,5 +3,6 @@
 
 void interned_strings_init();
 void interned_strings_free();
+void interned_strings_remove_unmarked();
 
 String* intern_string(const char* data, int length);
@@ -1,4 +1,5 @@
 #pragma once
+#include <limits.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "hash.h"
@@ -10,42 +11,204 @@ typedef enum {
     VALUE_BOOL,
     VALUE_STRING,
     VALUE_LIST,
+    VALUE_MAP,
     VALUE_NATIVE,
     VALUE_FUNCTION,
     VALUE_MODULE,
 } ValueType;
 
+typedef enum {
+    OBJ_STRING,
+    OBJ_LIST,
+    OBJ_MAP,
+    OBJ_NATIVE,
+    OBJ_FUNCTION,
+    OBJ_MODULE,
+    OBJ_ENVIRONMENT,
+} ObjType;
+
+// header of every garbage collected object
+typedef struct Obj {
+    struct Obj* next;  // all objects are linked, so sweep can visit them
+    ObjType type;
+    bool marked;
+    bool pinned;       // referenced by AST or bytecode, never collected
+} Obj;
+
+// Strings from source code and natives are interned, so they can be compared by pointer.
+// Concatenation instead creates a rope node linking both halves, which is flattened
+// into a single buffer only when its characters are needed.
 typedef struct String {
+    Obj obj;
     int length;
-    Hash hash;
-    char data[];
+    Hash hash;             // set only for interned strings
+    bool interned;
+    char* data;            // NULL until rope is flattened, use string_data()
+    struct String* left;   // halves of rope, NULL once flattened
+    struct String* right;
+    char chars[];          // storage of strings created flat
 } String;
 
+#ifdef NAN_BOXING
+typedef uint64_t Value;
+#else
 typedef struct Value Value;
+#endif
+
+// elements stay unboxed while they all are ints or all are floats
+typedef enum {
+    LIST_INTS,
+    LIST_FLOATS,
+    LIST_VALUES,
+} ListKind;
 
 typedef struct {
+    Obj obj;
+    ListKind kind;
     int length;
     int capacity;
-    Value* values;
+    union {
+        int64_t* ints;
+        double* floats;
+        Value* values;
+    };
 } List;
 
+typedef struct MapEntry MapEntry;
+
+typedef struct {
+    Obj obj;
+    MapEntry* entries;
+    int capacity;
+    int count;  // keys present
+    int used;   // entries with key or tombstone
+} Map;
+
+// argc is always within arity of native, callers check it before the call
 typedef Value (*NativeFn)(int argc, Value* argv);
 
+#define NATIVE_VARIADIC INT_MAX  // max_arity of natives taking any number of arguments
+
+typedef struct {
+    Obj obj;
+    String* name;
+    NativeFn function;
+    int min_arity;
+    int max_arity;
+} Native;
+
 struct ASTNode;
+struct Chunk;
 struct Environment;
 
 typedef struct {
+    Obj obj;
     String* name;
     String** params;
     int param_count;
-    struct ASTNode* body;
+    struct ASTNode* body;          // used by tree-walk interpreter
+    struct Chunk* chunk;           // used by bytecode vm
+    struct Environment* globals;   // globals of module in which function was declared
 } Function;
 
 typedef struct {
+    Obj obj;
     String* name;
     struct Environment* env;
 } Module;
 
+#ifdef NAN_BOXING
+
+// Every value is a single 64-bit word. Anything that is not a quiet NaN with
+// QNAN bits set is a float. Otherwise the sign bit and bits 48-49 hold a tag
+// and the low 48 bits hold the payload: a pointer, a 48-bit signed integer,
+// or for null and bools the singleton number.
+
+#define SIGN_BIT     ((uint64_t)0x8000000000000000)
+#define QNAN         ((uint64_t)0x7ffc000000000000)
+#define TAG_MASK     ((uint64_t)0xffff000000000000)
+#define PAYLOAD_MASK ((uint64_t)0x0000ffffffffffff)
+#define BOX(tag)     (QNAN | ((uint64_t)((tag) & 4) << 61) | ((uint64_t)((tag) & 3) << 48))
+
+#define TAG_SINGLETON 0
+#define TAG_INT       1
+#define TAG_STRING    2
+#define TAG_LIST      3
+#define TAG_NATIVE    4
+#define TAG_FUNCTION  5
+#define TAG_MODULE    6
+#define TAG_MAP       7
+
+#define INT_VALUE_MAX ((int64_t)(PAYLOAD_MASK >> 1))  // ints are 48-bit, results beyond are an error
+#define INT_VALUE_MIN (-INT_VALUE_MAX - 1)
+
+#define NULL_BITS  (BOX(TAG_SINGLETON) | 0)
+#define FALSE_BITS (BOX(TAG_SINGLETON) | 2)
+#define TRUE_BITS  (BOX(TAG_SINGLETON) | 3)
+
+typedef union {
+    Value bits;
+    double floating;
+} FloatBits;
+
+static inline Value value_from_float(double floating) {
+    return ((FloatBits){ .floating = floating }).bits;
+}
+
+static inline double value_as_float(Value value) {
+    return ((FloatBits){ .bits = value }).floating;
+}
+
+static inline ValueType value_get_type(Value value) {
+    static const ValueType types[] = {
+        VALUE_NULL, VALUE_INT, VALUE_STRING, VALUE_LIST, VALUE_NATIVE, VALUE_FUNCTION, VALUE_MODULE, VALUE_MAP,
+    };
+    if ((value & QNAN) != QNAN) return VALUE_FLOAT;
+    if ((value & TAG_MASK) == BOX(TAG_SINGLETON)) return value == NULL_BITS ? VALUE_NULL : VALUE_BOOL;
+    return types[((value >> 61) & 4) | ((value >> 48) & 3)];
+}
+
+#define HAS_TAG(value, tag)   (((value) & TAG_MASK) == BOX(tag))
+
+#define VALUE_TYPE(value)     value_get_type(value)
+
+#define IS_NULL(value)        ((value) == NULL_BITS)
+#define IS_INT(value)         HAS_TAG(value, TAG_INT)
+#define IS_FLOAT(value)       (((value) & QNAN) != QNAN)
+#define IS_BOOL(value)        (((value) | 1) == TRUE_BITS)
+#define IS_STRING(value)      HAS_TAG(value, TAG_STRING)
+#define IS_LIST(value)        HAS_TAG(value, TAG_LIST)
+#define IS_MAP(value)         HAS_TAG(value, TAG_MAP)
+#define IS_NATIVE(value)      HAS_TAG(value, TAG_NATIVE)
+#define IS_FUNCTION(value)    HAS_TAG(value, TAG_FUNCTION)
+#define IS_MODULE(value)      HAS_TAG(value, TAG_MODULE)
+
+#define AS_INT(value)         ((int64_t)((value) << 16) >> 16)
+#define AS_FLOAT(value)       value_as_float(value)
+#define AS_BOOL(value)        ((bool)((value) & 1))
+#define AS_STRING(value)      ((String*)(uintptr_t)((value) & PAYLOAD_MASK))
+#define AS_LIST(value)        ((List*)(uintptr_t)((value) & PAYLOAD_MASK))
+#define AS_MAP(value)         ((Map*)(uintptr_t)((value) & PAYLOAD_MASK))
+#define AS_NATIVE(value)      ((Native*)(uintptr_t)((value) & PAYLOAD_MASK))
+#define AS_FUNCTION(value)    ((Function*)(uintptr_t)((value) & PAYLOAD_MASK))
+#define AS_MODULE(value)      ((Module*)(uintptr_t)((value) & PAYLOAD_MASK))
+
+#define NULL_VALUE()          ((Value)NULL_BITS)
+#define INT_VALUE(value)      ((Value)(BOX(TAG_INT) | ((uint64_t)(int64_t)(value) & PAYLOAD_MASK)))
+#define FLOAT_VALUE(value)    value_from_float(value)
+#define BOOL_VALUE(value)     ((Value)((value) ? TRUE_BITS : FALSE_BITS))
+#define STRING_VALUE(value)   ((Value)(BOX(TAG_STRING) | (uint64_t)(uintptr_t)(value)))
+#define LIST_VALUE(value)     ((Value)(BOX(TAG_LIST) | (uint64_t)(uintptr_t)(value)))
+#define MAP_VALUE(value)      ((Value)(BOX(TAG_MAP) | (uint64_t)(uintptr_t)(value)))
+#define NATIVE_VALUE(value)   ((Value)(BOX(TAG_NATIVE) | (uint64_t)(uintptr_t)(value)))
+#define FUNCTION_VALUE(value) ((Value)(BOX(TAG_FUNCTION) | (uint64_t)(uintptr_t)(value)))
+#define MODULE_VALUE(value)   ((Value)(BOX(TAG_MODULE) | (uint64_t)(uintptr_t)(value)))
+
+#else
+
+#define INT_VALUE_MAX INT64_MAX
+#define INT_VALUE_MIN INT64_MIN
+
 struct Value {
     ValueType type;
     union {
@@ -54,32 +217,55 @@ struct Value {
         bool boolean;
         String* string;
         List* list;
-        NativeFn native;
+        Map* map;
+        Native* native;
         Function* function;
         Module* module;
     };
 };
 
+#define VALUE_TYPE(value)     ((value).type)
+
 #define IS_NULL(value)        ((value).type == VALUE_NULL)
 #define IS_INT(value)         ((value).type == VALUE_INT)
 #define IS_FLOAT(value)       ((value).type == VALUE_FLOAT)
 #define IS_BOOL(value)        ((value).type == VALUE_BOOL)
 #define IS_STRING(value)      ((value).type == VALUE_STRING)
 #define IS_LIST(value)        ((value).type == VALUE_LIST)
+#define IS_MAP(value)         ((value).type == VALUE_MAP)
 #define IS_NATIVE(value)      ((value).type == VALUE_NATIVE)
 #define IS_FUNCTION(value)    ((value).type == VALUE_FUNCTION)
 #define IS_MODULE(value)      ((value).type == VALUE_MODULE)
 
+#define AS_INT(value)         ((value).integer)
+#define AS_FLOAT(value)       ((value).floating)
+#define AS_BOOL(value)        ((value).boolean)
+#define AS_STRING(value)      ((value).string)
+#define AS_LIST(value)        ((value).list)
+#define AS_MAP(value)         ((value).map)
+#define AS_NATIVE(value)      ((value).native)
+#define AS_FUNCTION(value)    ((value).function)
+#define AS_MODULE(value)      ((value).module)
+
 #define NULL_VALUE()          ((Value){ .type = VALUE_NULL,     .integer = 0 })
 #define INT_VALUE(value)      ((Value){ .type = VALUE_INT,      .integer = value })
 #define FLOAT_VALUE(value)    ((Value){ .type = VALUE_FLOAT,    .floating = value })
 #define BOOL_VALUE(value)     ((Value){ .type = VALUE_BOOL,     .boolean = value })
 #define STRING_VALUE(value)   ((Value){ .type = VALUE_STRING,   .string = value })
 #define LIST_VALUE(value)     ((Value){ .type = VALUE_LIST,     .list = value })
+#define MAP_VALUE(value)      ((Value){ .type = VALUE_MAP,      .map = value })
 #define NATIVE_VALUE(value)   ((Value){ .type = VALUE_NATIVE,   .native = value })
 #define FUNCTION_VALUE(value) ((Value){ .type = VALUE_FUNCTION, .function = value })
 #define MODULE_VALUE(value)   ((Value){ .type = VALUE_MODULE,   .module = value })
 
+#endif
+
+// entry with null key is empty, or a tombstone of removed key if its value is true
+struct MapEntry {
+    Value key;
+    Value value;
+};
+
 const char* value_type_as_cstr(ValueType type);
 
 void print_value(Value value);
@@ -88,10 +274,34 @@ bool values_equal(Value a, Value b);
 String* string_create(int length, Hash hash, const char* data);  // used internally by functions below
 String* string_new(const char* data, int length);
 String* string_from(const char* data);
-String* string_concat(String* a, String* b);
+String* string_concat(String* a, String* b);  // both strings must be reachable by GC
+char* string_data(String* string);
+String* string_intern(String* string);  // canonical interned copy, string must be reachable by GC
 bool strings_equal(String* a, String* b);
 
-List* list_new(int length);
+List* list_new(int capacity);
+List* list_new_packed(ListKind kind, int length);  // elements are zero
+void list_append(List* list, Value value);
+void list_set(List* list, int index, Value value);
+void list_box(List* list);  // converts elements to boxed values
+size_t list_element_size(ListKind kind);
 bool lists_equal(List* a, List* b);
 
+// ints outside of INT_VALUE_MIN..INT_VALUE_MAX can't be stored in a Value
+static inline bool int_fits(int64_t value) {
+    return value >= INT_VALUE_MIN && value <= INT_VALUE_MAX;
+}
+
+static inline Value list_get(List* list, int index) {
+    switch (list->kind) {
+        case LIST_INTS:   return INT_VALUE(list->ints[index]);
+        case LIST_FLOATS: return FLOAT_VALUE(list->floats[index]);
+        default:          return list->values[index];
+    }
+}
+
+Native* native_new(String* name, NativeFn function, int min_arity, int max_arity);
+
+Function* function_new(String* name, String** params, int param_count, struct ASTNode* body);
+
 Module* module_new(String* name, struct Environment* env);
@@ -0,0 +1,24 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "lexer.h"
+
+// kernels over packed list storage, vectorised with SSE2 where available
+
+// int kernels return false, or index of failing element, when result leaves int range of Value
+bool vector_sum_ints(const int64_t* a, int count, int64_t* sum);
+double vector_sum_floats(const double* a, int count);
+
+// count must be at least 1
+int64_t vector_min_ints(const int64_t* a, int count);
+int64_t vector_max_ints(const int64_t* a, int count);
+double vector_min_floats(const double* a, int count);
+double vector_max_floats(const double* a, int count);
+
+bool vector_dot_ints(const int64_t* a, const int64_t* b, int count, int64_t* sum);
+double vector_dot_floats(const double* a, const double* b, int count);
+
+// out[i] = a[i] op b[i], or a[i] op b[0] when b_step is 0; op is one of + - * /
+// returns -1 when all elements are computed, division by zero also fails
+int vector_op_ints(TokenType op, int64_t* out, const int64_t* a, const int64_t* b, int b_step, int count);
+void vector_op_floats(TokenType op, double* out, const double* a, const double* b, int b_step, int count);
@@ -0,0 +1,6 @@
+#pragma once
+#include "parser.h"
+#include "value.h"
+
+Value vm_interpret(ASTNode* root);
+void vm_mark_roots();
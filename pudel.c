@@ -1,34 +1,104 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "arena.h"
+#include "astcache.h"
 #include "debug.h"
 #include "interpreter.h"
-#include "io.h"
-#include "parser.h"
+#include "memory.h"
+#include "profiler.h"
 #include "strings.h"
+#include "vm.h"
+
+static double now_ms() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+// single line of key=value pairs, read by bench/run.sh
+static void print_stats(double start_ms) {
+    GCStats gc = gc_stats();
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stderr, "stats: wall_ms=%.3f allocations=%zu allocated_bytes=%zu collections=%zu peak_rss_kb=%ld\n",
+            now_ms() - start_ms, gc.allocations, gc.allocated_bytes, gc.collections, usage.ru_maxrss);
+}
+
+static void usage(const char* program) {
+    fprintf(stderr, "usage: %s [--vm] [--gc-growth <factor>] [--stats] [--profile <report>] [--no-cache] <input.pud>\n", program);
+    exit(1);
+}
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        fprintf(stderr, "usage: %s <input.pud>\n", argv[0]);
-        exit(1);
+    double start_ms = now_ms();
+    bool use_vm = false;
+    bool show_stats = false;
+    const char* profile_path = NULL;
+    const char* input_path = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--vm") == 0) {
+            use_vm = true;
+        }
+        else if (strcmp(argv[i], "--no-cache") == 0) {
+            astcache_set_enabled(false);
+        }
+        else if (strcmp(argv[i], "--stats") == 0) {
+            show_stats = true;
+        }
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--gc-growth") == 0 && i + 1 < argc) {
+            double factor = strtod(argv[++i], NULL);
+            if (factor <= 1.0) {
+                fprintf(stderr, "gc growth factor must be greater than 1\n");
+                exit(1);
+            }
+            gc_set_growth(factor);
+        }
+        else if (input_path == NULL && argv[i][0] != '-') {
+            input_path = argv[i];
+        }
+        else {
+            usage(argv[0]);
+        }
+    }
+    if (input_path == NULL) {
+        usage(argv[0]);
     }
-    char* source = file_read(argv[1]);
-
     interned_strings_init();
 
+    Arena arena;
+    arena_init(&arena);
     ASTNode* ast;
-    if (!parser_parse(source, &ast)) {
-        // don't free ast, because it might be corrupted
-        free(source);
+    if (!astcache_parse_file(input_path, &arena, &ast)) {
+        arena_free(&arena);
         return 1;
     }
     debug_print_ast(ast, 0);
 
     printf("----------------------------------------------------------------\n");
 
-    interpreter_interpret(ast);
+    if (profile_path != NULL) {
+        profiler_start(profile_path);
+    }
+    if (use_vm) {
+        vm_interpret(ast);
+    }
+    else {
+        interpreter_interpret(ast);
+    }
 
-    parser_free_ast(ast);
-    free(source);
+    // report names functions, which are freed with the rest of the heap
+    profiler_stop();
+    arena_free(&arena);
+    gc_free_all();
     interned_strings_free();
+    if (show_stats) {
+        print_stats(start_ms);
+    }
     return 0;
 }
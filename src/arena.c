@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+static size_t align(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+void arena_init(Arena* arena) {
+    arena->blocks = NULL;
+    arena->last = NULL;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = align(size);
+    ArenaBlock* block = arena->blocks;
+    if (block == NULL || block->used + size > block->capacity) {
+        size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = calloc(1, sizeof(ArenaBlock) + capacity);
+        if (block == NULL) {
+            fprintf(stderr, "arena::arena_alloc: cannot allocate enough memory\n");
+            exit(1);
+        }
+        block->capacity = capacity;
+        block->used = 0;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    void* pointer = block->data + block->used;
+    block->used += size;
+    arena->last = pointer;
+    return pointer;
+}
+
+void* arena_grow(Arena* arena, void* pointer, size_t old_size, size_t new_size) {
+    ArenaBlock* block = arena->blocks;
+    if (pointer != NULL && pointer == arena->last) {
+        size_t offset = (char*)pointer - block->data;
+        if (offset + align(new_size) <= block->capacity) {
+            block->used = offset + align(new_size);
+            return pointer;
+        }
+    }
+
+    void* new_pointer = arena_alloc(arena, new_size);
+    if (old_size > 0) {
+        memcpy(new_pointer, pointer, old_size);
+    }
+    return new_pointer;
+}
+
+void arena_free(Arena* arena) {
+    ArenaBlock* block = arena->blocks;
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+    arena->last = NULL;
+}
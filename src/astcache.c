@@ -0,0 +1,747 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "astcache.h"
+#include "hash.h"
+#include "hashmap.h"
+#include "io.h"
+#include "memory.h"
+#include "optimizer.h"
+#include "resolver.h"
+#include "strings.h"
+
+#define NULL_NODE 0xff
+#define NULL_STRING -1
+
+// identifies source the cache was made from
+typedef struct {
+    int64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    Hash hash;
+} SourceStamp;
+
+typedef struct {
+    uint8_t* data;
+    int count;
+    int capacity;
+    HashMap string_indices;  // string -> its index in string table
+    String** strings;
+    int string_count;
+    int string_capacity;
+} Writer;
+
+typedef struct {
+    const uint8_t* data;
+    size_t length;
+    size_t offset;
+    bool failed;  // data is truncated or malformed, all further reads return zero
+    String** strings;
+    int string_count;
+    int slot_count;  // slots of call frame visible to node being read
+    Arena* arena;
+} Reader;
+
+static bool enabled = true;
+
+void astcache_set_enabled(bool value) {
+    enabled = value;
+}
+
+static char* cache_path(const char* path) {
+    char* result = malloc(strlen(path) + sizeof(AST_CACHE_SUFFIX));
+    strcpy(result, path);
+    strcat(result, AST_CACHE_SUFFIX);
+    return result;
+}
+
+static bool source_stamp(const char* path, MappedFile* source, SourceStamp* stamp) {
+    struct stat info;
+    if (stat(path, &info) != 0) return false;
+    stamp->size = info.st_size;
+    stamp->mtime_sec = info.st_mtim.tv_sec;
+    stamp->mtime_nsec = info.st_mtim.tv_nsec;
+    stamp->hash = hash_cstring(source->data, source->length);
+    return true;
+}
+
+// writing
+
+static void write_bytes(Writer* writer, const void* bytes, int length) {
+    if (writer->count + length > writer->capacity) {
+        while (writer->count + length > writer->capacity) {
+            writer->capacity = GROW_CAPACITY(writer->capacity);
+        }
+        writer->data = GROW_ARRAY(uint8_t, writer->data, writer->capacity);
+    }
+    memcpy(writer->data + writer->count, bytes, length);
+    writer->count += length;
+}
+
+static void write_u8(Writer* writer, uint8_t value) {
+    write_bytes(writer, &value, sizeof(value));
+}
+
+// integers are zigzag encoded varints, so small magnitudes of either sign take one byte
+static void write_i64(Writer* writer, int64_t value) {
+    uint64_t bits = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    while (bits >= 0x80) {
+        write_u8(writer, (uint8_t)(bits | 0x80));
+        bits >>= 7;
+    }
+    write_u8(writer, (uint8_t)bits);
+}
+
+static void write_i32(Writer* writer, int32_t value) {
+    write_i64(writer, value);
+}
+
+static void write_string(Writer* writer, String* string) {
+    if (string == NULL) {
+        write_i32(writer, NULL_STRING);
+        return;
+    }
+    Value* index = hashmap_get_ref(&writer->string_indices, string);
+    if (index != NULL) {
+        write_i32(writer, AS_INT(*index));
+        return;
+    }
+    if (writer->string_count + 1 > writer->string_capacity) {
+        writer->string_capacity = GROW_CAPACITY(writer->string_capacity);
+        writer->strings = GROW_ARRAY(String*, writer->strings, writer->string_capacity);
+    }
+    hashmap_put(&writer->string_indices, string, INT_VALUE(writer->string_count));
+    writer->strings[writer->string_count] = string;
+    write_i32(writer, writer->string_count++);
+}
+
+static void write_value(Writer* writer, Value value) {
+    ValueType type = VALUE_TYPE(value);
+    write_u8(writer, type);
+    switch (type) {
+        case VALUE_INT:    write_i64(writer, AS_INT(value)); break;
+        case VALUE_FLOAT: {
+            double floating = AS_FLOAT(value);
+            write_bytes(writer, &floating, sizeof(floating));
+        } break;
+        case VALUE_BOOL:   write_u8(writer, AS_BOOL(value)); break;
+        case VALUE_STRING: write_string(writer, AS_STRING(value)); break;
+        default: break;  // null, other types are never literals
+    }
+}
+
+static void write_node(Writer* writer, ASTNode* root);
+
+static void write_nodes(Writer* writer, ASTNode** nodes, int count) {
+    write_i32(writer, count);
+    for (int i = 0; i < count; ++i) {
+        write_node(writer, nodes[i]);
+    }
+}
+
+static void write_node(Writer* writer, ASTNode* root) {
+    if (root == NULL) {
+        write_u8(writer, NULL_NODE);
+        return;
+    }
+    write_u8(writer, root->type);
+    write_i32(writer, root->line);
+
+    switch (root->type) {
+        case AST_NODE_PROGRAM:
+        case AST_NODE_BLOCK: {
+            ASTNodeBlock* block = (ASTNodeBlock*)root;
+            write_i32(writer, block->local_count);
+            write_nodes(writer, block->statements, block->count);
+        } break;
+        case AST_NODE_IMPORT: {
+            ASTNodeImport* import = (ASTNodeImport*)root;
+            write_string(writer, import->path);
+            write_string(writer, import->name);
+            write_i32(writer, import->slot);
+        } break;
+        case AST_NODE_FUNC_DECL: {
+            ASTNodeFuncDecl* func_decl = (ASTNodeFuncDecl*)root;
+            write_string(writer, func_decl->name);
+            write_i32(writer, func_decl->param_count);
+            for (int i = 0; i < func_decl->param_count; ++i) {
+                write_string(writer, func_decl->params[i]);
+            }
+            write_node(writer, func_decl->body);
+        } break;
+        case AST_NODE_VAR_DECL: {
+            ASTNodeVarDecl* var_decl = (ASTNodeVarDecl*)root;
+            write_string(writer, var_decl->name);
+            write_i32(writer, var_decl->slot);
+            write_node(writer, var_decl->initializer);
+        } break;
+        case AST_NODE_EXPR_STMT:
+        case AST_NODE_RETURN_STMT: {
+            write_node(writer, ((ASTNodeExprStmt*)root)->expression);
+        } break;
+        case AST_NODE_IF_STMT:
+        case AST_NODE_TERNARY: {
+            ASTNodeIfStmt* if_stmt = (ASTNodeIfStmt*)root;
+            write_node(writer, if_stmt->condition);
+            write_node(writer, if_stmt->then_branch);
+            write_node(writer, if_stmt->else_branch);
+        } break;
+        case AST_NODE_WHILE_STMT: {
+            ASTNodeWhileStmt* while_stmt = (ASTNodeWhileStmt*)root;
+            write_node(writer, while_stmt->condition);
+            write_node(writer, while_stmt->body);
+        } break;
+        case AST_NODE_FOR_STMT: {
+            ASTNodeForStmt* for_stmt = (ASTNodeForStmt*)root;
+            write_i32(writer, for_stmt->local_count);
+            write_node(writer, for_stmt->initializer);
+            write_node(writer, for_stmt->condition);
+            write_node(writer, for_stmt->increment);
+            write_node(writer, for_stmt->body);
+        } break;
+        case AST_NODE_FOR_IN_STMT: {
+            ASTNodeForInStmt* for_in = (ASTNodeForInStmt*)root;
+            write_string(writer, for_in->name);
+            write_i32(writer, for_in->slot);
+            write_node(writer, for_in->iterable);
+            write_node(writer, for_in->body);
+        } break;
+        case AST_NODE_BREAK:
+        case AST_NODE_CONTINUE:
+            break;
+        case AST_NODE_ASSIGNMENT: {
+            ASTNodeAssignment* assignment = (ASTNodeAssignment*)root;
+            write_i32(writer, assignment->op);
+            write_node(writer, assignment->target);
+            write_node(writer, assignment->value);
+        } break;
+        case AST_NODE_LOGICAL:
+        case AST_NODE_BINARY: {
+            ASTNodeBinary* binary = (ASTNodeBinary*)root;
+            write_i32(writer, binary->op);
+            write_node(writer, binary->left);
+            write_node(writer, binary->right);
+        } break;
+        case AST_NODE_UNARY: {
+            ASTNodeUnary* unary = (ASTNodeUnary*)root;
+            write_i32(writer, unary->op);
+            write_node(writer, unary->right);
+        } break;
+        case AST_NODE_CALL: {
+            ASTNodeCall* call = (ASTNodeCall*)root;
+            write_node(writer, call->callee);
+            write_nodes(writer, call->arguments, call->count);
+        } break;
+        case AST_NODE_GET: {
+            ASTNodeGet* get = (ASTNodeGet*)root;
+            write_string(writer, get->name);
+            write_node(writer, get->object);
+        } break;
+        case AST_NODE_SUBSCRIPTION: {
+            ASTNodeSubscription* subscription = (ASTNodeSubscription*)root;
+            write_node(writer, subscription->expression);
+            write_node(writer, subscription->index);
+        } break;
+        case AST_NODE_LITERAL: {
+            write_value(writer, ((ASTNodeLiteral*)root)->value);
+        } break;
+        case AST_NODE_VAR: {
+            ASTNodeVar* var = (ASTNodeVar*)root;
+            write_string(writer, var->name);
+            write_i32(writer, var->slot);
+        } break;
+        case AST_NODE_LIST: {
+            ASTNodeList* list = (ASTNodeList*)root;
+            write_nodes(writer, list->expressions, list->count);
+        } break;
+        case AST_NODE_MAP: {
+            ASTNodeMap* map = (ASTNodeMap*)root;
+            write_nodes(writer, map->keys, map->count);
+            write_nodes(writer, map->values, map->count);
+        } break;
+    }
+}
+
+// file is written under temporary name and renamed, so concurrent runs never read partial cache
+static void store(const char* path, SourceStamp* stamp, ASTNode* root) {
+    Writer tree = {0};
+    tree.string_indices = hashmap_create();
+    write_node(&tree, root);
+
+    // payload is string table followed by tree, which refers to strings by index
+    Writer payload = {0};
+    write_i32(&payload, tree.string_count);
+    for (int i = 0; i < tree.string_count; ++i) {
+        String* string = tree.strings[i];
+        write_i32(&payload, string->length);
+        write_bytes(&payload, string_data(string), string->length);
+    }
+    write_bytes(&payload, tree.data, tree.count);
+
+    Writer header = {0};
+    write_bytes(&header, AST_CACHE_MAGIC, 4);
+    write_i32(&header, AST_CACHE_VERSION);
+    write_i64(&header, stamp->size);
+    write_i64(&header, stamp->mtime_sec);
+    write_i64(&header, stamp->mtime_nsec);
+    write_i64(&header, stamp->hash);
+    write_i64(&header, hash_cstring((const char*)payload.data, payload.count));
+
+    char* final_path = cache_path(path);
+    char* temporary_path = malloc(strlen(final_path) + 32);
+    sprintf(temporary_path, "%s.%d.tmp", final_path, (int)getpid());
+
+    // cache is only an optimization, unwritable directories are silently skipped
+    FILE* file = fopen(temporary_path, "wb");
+    if (file != NULL) {
+        bool written = fwrite(header.data, 1, header.count, file) == (size_t)header.count
+                    && fwrite(payload.data, 1, payload.count, file) == (size_t)payload.count;
+        if (fclose(file) == 0 && written) {
+            rename(temporary_path, final_path);
+        }
+        else {
+            remove(temporary_path);
+        }
+    }
+
+    free(temporary_path);
+    free(final_path);
+    free(header.data);
+    free(payload.data);
+    free(tree.data);
+    free(tree.strings);
+    hashmap_free(&tree.string_indices);
+}
+
+// reading
+
+static void read_bytes(Reader* reader, void* bytes, size_t length) {
+    if (reader->failed || reader->offset + length > reader->length) {
+        reader->failed = true;
+        memset(bytes, 0, length);
+        return;
+    }
+    memcpy(bytes, reader->data + reader->offset, length);
+    reader->offset += length;
+}
+
+static uint8_t read_u8(Reader* reader) {
+    uint8_t value;
+    read_bytes(reader, &value, sizeof(value));
+    return value;
+}
+
+static int64_t read_i64(Reader* reader) {
+    uint64_t bits = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = read_u8(reader);
+        bits |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return (int64_t)(bits >> 1) ^ -(int64_t)(bits & 1);
+        }
+    }
+    reader->failed = true;
+    return 0;
+}
+
+static int32_t read_i32(Reader* reader) {
+    int64_t value = read_i64(reader);
+    if (value < INT32_MIN || value > INT32_MAX) {
+        reader->failed = true;
+        return 0;
+    }
+    return (int32_t)value;
+}
+
+static String* read_string(Reader* reader) {
+    int32_t index = read_i32(reader);
+    if (index == NULL_STRING) return NULL;
+    if (index < 0 || index >= reader->string_count) {
+        reader->failed = true;
+        return NULL;
+    }
+    return reader->strings[index];
+}
+
+static Value read_value(Reader* reader) {
+    switch (read_u8(reader)) {
+        case VALUE_NULL:   return NULL_VALUE();
+        case VALUE_INT: {
+            // cache may have been written by build with the other value layout
+            int64_t integer = read_i64(reader);
+            if (!int_fits(integer)) break;
+            return INT_VALUE(integer);
+        }
+        case VALUE_FLOAT: {
+            double floating;
+            read_bytes(reader, &floating, sizeof(floating));
+            return FLOAT_VALUE(floating);
+        }
+        case VALUE_BOOL: {
+            uint8_t boolean = read_u8(reader);
+            if (boolean > 1) break;
+            return BOOL_VALUE(boolean);
+        }
+        case VALUE_STRING: {
+            String* string = read_string(reader);
+            if (string == NULL) break;
+            return STRING_VALUE(string);
+        }
+        default: break;
+    }
+    reader->failed = true;
+    return NULL_VALUE();
+}
+
+static int read_count(Reader* reader) {
+    int32_t count = read_i32(reader);
+    // every element takes at least one byte, which bounds allocations made for corrupted counts
+    if (count < 0 || (size_t)count > reader->length - reader->offset) {
+        reader->failed = true;
+        return 0;
+    }
+    return count;
+}
+
+// slot indexes stack of interpreter, so it has to be one of the visible ones or -1 for global
+static int read_slot(Reader* reader) {
+    int32_t slot = read_i32(reader);
+    if (slot < -1 || slot >= reader->slot_count) {
+        reader->failed = true;
+        return -1;
+    }
+    return slot;
+}
+
+static bool is_operator_of(ASTNodeType type, int32_t op) {
+    switch (type) {
+        case AST_NODE_ASSIGNMENT:
+            return op == TOKEN_EQUAL || op == TOKEN_PLUS_EQUAL || op == TOKEN_MINUS_EQUAL || op == TOKEN_ASTERISK_EQUAL
+                || op == TOKEN_SLASH_EQUAL || op == TOKEN_PERCENT_EQUAL;
+        case AST_NODE_LOGICAL:
+            return op == TOKEN_AND || op == TOKEN_OR;
+        case AST_NODE_UNARY:
+            return op == TOKEN_MINUS || op == TOKEN_NOT;
+        default:
+            return op == TOKEN_PLUS || op == TOKEN_MINUS || op == TOKEN_ASTERISK || op == TOKEN_SLASH || op == TOKEN_PERCENT
+                || op == TOKEN_EQUAL_EQUAL || op == TOKEN_NOT_EQUAL || op == TOKEN_GREATER || op == TOKEN_GREATER_EQUAL
+                || op == TOKEN_LESS || op == TOKEN_LESS_EQUAL;
+    }
+}
+
+static TokenType read_operator(Reader* reader, ASTNodeType type) {
+    int32_t op = read_i32(reader);
+    if (!is_operator_of(type, op)) reader->failed = true;
+    return (TokenType)op;
+}
+
+static int read_line(Reader* reader) {
+    int32_t line = read_i32(reader);
+    if (line < 0) reader->failed = true;
+    return line;
+}
+
+static void* make_node(Reader* reader, size_t size, ASTNodeType type, int line) {
+    ASTNode* node = arena_alloc(reader->arena, size);
+    node->type = type;
+    node->line = line;
+    return node;
+}
+
+static ASTNode* read_node(Reader* reader);
+
+// node that interpreter expects to be present
+static ASTNode* read_required_node(Reader* reader) {
+    ASTNode* node = read_node(reader);
+    if (node == NULL) reader->failed = true;
+    return node;
+}
+
+static ASTNode** read_nodes(Reader* reader, int* count) {
+    *count = read_count(reader);
+    ASTNode** nodes = arena_alloc(reader->arena, sizeof(ASTNode*) * (*count + 1));
+    for (int i = 0; i < *count && !reader->failed; ++i) {
+        nodes[i] = read_required_node(reader);
+    }
+    return nodes;
+}
+
+// slots of block are visible only to its statements, program declares globals instead
+static ASTNode* read_block(Reader* reader, ASTNodeType type, int line) {
+    ASTNodeBlock* block = make_node(reader, sizeof(ASTNodeBlock), type, line);
+    block->local_count = read_count(reader);
+    int slot_count = reader->slot_count;
+    if (type == AST_NODE_BLOCK) reader->slot_count += block->local_count;
+    block->statements = read_nodes(reader, &block->count);
+    block->capacity = block->count;
+    reader->slot_count = slot_count;
+    if (block->local_count > block->count) reader->failed = true;  // each is declared by a statement
+    return (ASTNode*)block;
+}
+
+static ASTNode* read_node(Reader* reader) {
+    uint8_t type = read_u8(reader);
+    if (type == NULL_NODE || reader->failed) return NULL;
+    int line = read_line(reader);
+
+    switch ((ASTNodeType)type) {
+        case AST_NODE_PROGRAM: break;  // only root of tree
+        case AST_NODE_BLOCK: {
+            return read_block(reader, type, line);
+        }
+        case AST_NODE_IMPORT: {
+            ASTNodeImport* import = make_node(reader, sizeof(ASTNodeImport), type, line);
+            import->path = read_string(reader);
+            import->name = read_string(reader);
+            import->slot = read_slot(reader);
+            if (import->path == NULL) reader->failed = true;
+            return (ASTNode*)import;
+        }
+        case AST_NODE_FUNC_DECL: {
+            ASTNodeFuncDecl* func_decl = make_node(reader, sizeof(ASTNodeFuncDecl), type, line);
+            func_decl->name = read_string(reader);
+            func_decl->param_count = read_count(reader);
+            func_decl->params = arena_alloc(reader->arena, sizeof(String*) * (func_decl->param_count + 1));
+            for (int i = 0; i < func_decl->param_count; ++i) {
+                func_decl->params[i] = read_string(reader);
+                if (func_decl->params[i] == NULL) reader->failed = true;
+            }
+            // function has call frame of its own, starting with parameters
+            int slot_count = reader->slot_count;
+            reader->slot_count = func_decl->param_count;
+            func_decl->body = read_required_node(reader);
+            reader->slot_count = slot_count;
+            if (func_decl->name == NULL) reader->failed = true;
+            return (ASTNode*)func_decl;
+        }
+        case AST_NODE_VAR_DECL: {
+            ASTNodeVarDecl* var_decl = make_node(reader, sizeof(ASTNodeVarDecl), type, line);
+            var_decl->name = read_string(reader);
+            var_decl->slot = read_slot(reader);
+            var_decl->initializer = read_node(reader);
+            if (var_decl->name == NULL) reader->failed = true;
+            return (ASTNode*)var_decl;
+        }
+        case AST_NODE_EXPR_STMT: {
+            ASTNodeExprStmt* stmt = make_node(reader, sizeof(ASTNodeExprStmt), type, line);
+            stmt->expression = read_required_node(reader);
+            return (ASTNode*)stmt;
+        }
+        case AST_NODE_RETURN_STMT: {
+            ASTNodeExprStmt* stmt = make_node(reader, sizeof(ASTNodeExprStmt), type, line);
+            stmt->expression = read_node(reader);
+            return (ASTNode*)stmt;
+        }
+        case AST_NODE_IF_STMT:
+        case AST_NODE_TERNARY: {
+            ASTNodeIfStmt* if_stmt = make_node(reader, sizeof(ASTNodeIfStmt), type, line);
+            if_stmt->condition = read_required_node(reader);
+            if_stmt->then_branch = read_required_node(reader);
+            if_stmt->else_branch = type == AST_NODE_TERNARY ? read_required_node(reader) : read_node(reader);
+            return (ASTNode*)if_stmt;
+        }
+        case AST_NODE_WHILE_STMT: {
+            ASTNodeWhileStmt* while_stmt = make_node(reader, sizeof(ASTNodeWhileStmt), type, line);
+            while_stmt->condition = read_required_node(reader);
+            while_stmt->body = read_required_node(reader);
+            return (ASTNode*)while_stmt;
+        }
+        case AST_NODE_FOR_STMT: {
+            ASTNodeForStmt* for_stmt = make_node(reader, sizeof(ASTNodeForStmt), type, line);
+            for_stmt->local_count = read_count(reader);
+            if (for_stmt->local_count > 1) reader->failed = true;  // only initializer declares
+            int slot_count = reader->slot_count;
+            reader->slot_count += for_stmt->local_count;
+            for_stmt->initializer = read_node(reader);
+            for_stmt->condition = read_node(reader);
+            for_stmt->increment = read_node(reader);
+            for_stmt->body = read_required_node(reader);
+            reader->slot_count = slot_count;
+            return (ASTNode*)for_stmt;
+        }
+        case AST_NODE_FOR_IN_STMT: {
+            ASTNodeForInStmt* for_in = make_node(reader, sizeof(ASTNodeForInStmt), type, line);
+            for_in->name = read_string(reader);
+            // loop reserves two slots, iterated value and loop variable
+            int slot_count = reader->slot_count;
+            reader->slot_count += 2;
+            for_in->slot = read_slot(reader);
+            if (for_in->slot != slot_count + 1) reader->failed = true;
+            for_in->iterable = read_required_node(reader);
+            for_in->body = read_required_node(reader);
+            reader->slot_count = slot_count;
+            if (for_in->name == NULL) reader->failed = true;
+            return (ASTNode*)for_in;
+        }
+        case AST_NODE_BREAK:
+        case AST_NODE_CONTINUE: {
+            return make_node(reader, sizeof(ASTNode), type, line);
+        }
+        case AST_NODE_ASSIGNMENT: {
+            ASTNodeAssignment* assignment = make_node(reader, sizeof(ASTNodeAssignment), type, line);
+            assignment->op = read_operator(reader, type);
+            assignment->target = read_required_node(reader);
+            assignment->value = read_required_node(reader);
+            ASTNodeType target = assignment->target != NULL ? assignment->target->type : AST_NODE_VAR;
+            if (target != AST_NODE_VAR && target != AST_NODE_GET && target != AST_NODE_SUBSCRIPTION) reader->failed = true;
+            return (ASTNode*)assignment;
+        }
+        case AST_NODE_LOGICAL:
+        case AST_NODE_BINARY: {
+            ASTNodeBinary* binary = make_node(reader, sizeof(ASTNodeBinary), type, line);
+            binary->op = read_operator(reader, type);
+            binary->left = read_required_node(reader);
+            binary->right = read_required_node(reader);
+            return (ASTNode*)binary;
+        }
+        case AST_NODE_UNARY: {
+            ASTNodeUnary* unary = make_node(reader, sizeof(ASTNodeUnary), type, line);
+            unary->op = read_operator(reader, type);
+            unary->right = read_required_node(reader);
+            return (ASTNode*)unary;
+        }
+        case AST_NODE_CALL: {
+            ASTNodeCall* call = make_node(reader, sizeof(ASTNodeCall), type, line);
+            call->callee = read_required_node(reader);
+            call->arguments = read_nodes(reader, &call->count);
+            call->capacity = call->count;
+            return (ASTNode*)call;
+        }
+        case AST_NODE_GET: {
+            ASTNodeGet* get = make_node(reader, sizeof(ASTNodeGet), type, line);
+            get->name = read_string(reader);
+            get->object = read_required_node(reader);
+            if (get->name == NULL) reader->failed = true;
+            return (ASTNode*)get;
+        }
+        case AST_NODE_SUBSCRIPTION: {
+            ASTNodeSubscription* subscription = make_node(reader, sizeof(ASTNodeSubscription), type, line);
+            subscription->expression = read_required_node(reader);
+            subscription->index = read_required_node(reader);
+            return (ASTNode*)subscription;
+        }
+        case AST_NODE_LITERAL: {
+            ASTNodeLiteral* literal = make_node(reader, sizeof(ASTNodeLiteral), type, line);
+            literal->value = read_value(reader);
+            return (ASTNode*)literal;
+        }
+        case AST_NODE_VAR: {
+            ASTNodeVar* var = make_node(reader, sizeof(ASTNodeVar), type, line);
+            var->name = read_string(reader);
+            var->slot = read_slot(reader);
+            if (var->name == NULL) reader->failed = true;
+            return (ASTNode*)var;
+        }
+        case AST_NODE_LIST: {
+            ASTNodeList* list = make_node(reader, sizeof(ASTNodeList), type, line);
+            list->expressions = read_nodes(reader, &list->count);
+            list->capacity = list->count;
+            return (ASTNode*)list;
+        }
+        case AST_NODE_MAP: {
+            ASTNodeMap* map = make_node(reader, sizeof(ASTNodeMap), type, line);
+            map->keys = read_nodes(reader, &map->count);
+            int value_count;
+            map->values = read_nodes(reader, &value_count);
+            if (value_count != map->count) reader->failed = true;
+            map->capacity = map->count;
+            return (ASTNode*)map;
+        }
+    }
+    reader->failed = true;
+    return NULL;
+}
+
+static ASTNode* read_program(Reader* reader) {
+    if (read_u8(reader) != AST_NODE_PROGRAM) {
+        reader->failed = true;
+        return NULL;
+    }
+    int line = read_line(reader);
+    return read_block(reader, AST_NODE_PROGRAM, line);
+}
+
+static uint8_t* read_file(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+
+    uint8_t* data = size > 0 ? malloc(size) : NULL;
+    if (data != NULL && fread(data, 1, size, file) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *length = size;
+    return data;
+}
+
+// nodes are allocated in arena even if loading fails, they are freed with it
+static bool load(const char* path, SourceStamp* stamp, Arena* arena, ASTNode** output) {
+    char* path_of_cache = cache_path(path);
+    Reader reader = { .arena = arena };
+    reader.data = read_file(path_of_cache, &reader.length);
+    free(path_of_cache);
+    if (reader.data == NULL) return false;
+
+    char magic[4];
+    read_bytes(&reader, magic, sizeof(magic));
+    bool valid = memcmp(magic, AST_CACHE_MAGIC, sizeof(magic)) == 0
+              && read_i32(&reader) == AST_CACHE_VERSION
+              && read_i64(&reader) == stamp->size
+              && read_i64(&reader) == stamp->mtime_sec
+              && read_i64(&reader) == stamp->mtime_nsec
+              && read_i64(&reader) == stamp->hash;
+
+    // corrupted payload is caught here, checks made while decoding only keep it from crashing
+    Hash payload_hash = (Hash)read_i64(&reader);
+    valid = valid && !reader.failed
+         && payload_hash == hash_cstring((const char*)reader.data + reader.offset, reader.length - reader.offset);
+
+    if (valid) {
+        // strings referenced by AST must outlive any garbage collection, as in parser
+        gc_pin_begin();
+        reader.string_count = read_count(&reader);
+        reader.strings = malloc(sizeof(String*) * (reader.string_count + 1));
+        for (int i = 0; i < reader.string_count && !reader.failed; ++i) {
+            int length = read_count(&reader);
+            if (reader.failed) break;
+            reader.strings[i] = intern_string((const char*)reader.data + reader.offset, length);
+            reader.offset += length;
+        }
+        *output = read_program(&reader);
+        gc_pin_end();
+        valid = !reader.failed && reader.offset == reader.length;
+    }
+
+    free(reader.strings);
+    free((void*)reader.data);
+    return valid;
+}
+
+bool astcache_parse_file(const char* path, Arena* arena, ASTNode** output) {
+    MappedFile source = file_map(path);
+    SourceStamp stamp;
+    bool cacheable = enabled && source_stamp(path, &source, &stamp);
+
+    if (cacheable && load(path, &stamp, arena, output)) {
+        file_unmap(&source);
+        return true;
+    }
+
+    bool success = parser_parse(source.data, source.length, arena, output) && resolver_resolve(*output);
+    if (success) {
+        optimizer_fold_constants(*output, arena);
+    }
+    file_unmap(&source);
+    if (success && cacheable) {
+        store(path, &stamp, *output);
+    }
+    return success;
+}
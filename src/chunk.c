@@ -0,0 +1,44 @@
+#include <stdlib.h>
+#include "chunk.h"
+#include "memory.h"
+
+Chunk* chunk_new() {
+    return calloc(1, sizeof(Chunk));
+}
+
+void chunk_free(Chunk* chunk) {
+    free(chunk->code);
+    free(chunk->lines);
+    free(chunk->constants);
+    free(chunk->caches);
+    free(chunk);
+}
+
+void chunk_write(Chunk* chunk, uint8_t byte, int line) {
+    if (chunk->capacity < chunk->count + 1) {
+        chunk->capacity = GROW_CAPACITY(chunk->capacity);
+        chunk->code = GROW_ARRAY(uint8_t, chunk->code, chunk->capacity);
+        chunk->lines = GROW_ARRAY(int, chunk->lines, chunk->capacity);
+    }
+    chunk->code[chunk->count] = byte;
+    chunk->lines[chunk->count] = line;
+    ++chunk->count;
+}
+
+int chunk_add_constant(Chunk* chunk, Value value) {
+    if (chunk->constant_capacity < chunk->constant_count + 1) {
+        chunk->constant_capacity = GROW_CAPACITY(chunk->constant_capacity);
+        chunk->constants = GROW_ARRAY(Value, chunk->constants, chunk->constant_capacity);
+    }
+    chunk->constants[chunk->constant_count] = value;
+    return chunk->constant_count++;
+}
+
+int chunk_add_cache(Chunk* chunk) {
+    if (chunk->cache_capacity < chunk->cache_count + 1) {
+        chunk->cache_capacity = GROW_CAPACITY(chunk->cache_capacity);
+        chunk->caches = GROW_ARRAY(EnvCache, chunk->caches, chunk->cache_capacity);
+    }
+    chunk->caches[chunk->cache_count] = (EnvCache){ .env = NULL };
+    return chunk->cache_count++;
+}
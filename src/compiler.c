@@ -0,0 +1,607 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "chunk.h"
+#include "compiler.h"
+#include "memory.h"
+#include "parser.h"
+#include "value.h"
+
+#define LOCALS_MAX 256
+#define CONSTANTS_MAX 65536
+
+typedef struct {
+    String* name;
+    int depth;
+} Local;
+
+typedef struct Loop {
+    struct Loop* enclosing;
+    int start;        // offset which 'continue' jumps back to
+    int local_count;  // locals alive when loop started, popped by 'break' and 'continue'
+    int* breaks;
+    int break_count;
+    int break_capacity;
+} Loop;
+
+typedef struct Compiler {
+    struct Compiler* enclosing;
+    Function* function;
+    Local locals[LOCALS_MAX];
+    int local_count;
+    int scope_depth;
+    Loop* loop;
+} Compiler;
+
+static Compiler* current = NULL;
+static bool had_error = false;
+
+static void compile_error(int line, const char* format, ...) {
+    had_error = true;
+    fprintf(stderr, "[line %d] error: ", line);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputs("\n", stderr);
+}
+
+static Chunk* current_chunk() {
+    return current->function->chunk;
+}
+
+static void emit_byte(uint8_t byte, int line) {
+    chunk_write(current_chunk(), byte, line);
+}
+
+static void emit_bytes(uint8_t byte1, uint8_t byte2, int line) {
+    emit_byte(byte1, line);
+    emit_byte(byte2, line);
+}
+
+static void emit_short(uint16_t value, int line) {
+    emit_byte((value >> 8) & 0xff, line);
+    emit_byte(value & 0xff, line);
+}
+
+static uint16_t make_constant(Value value, int line) {
+    int index = chunk_add_constant(current_chunk(), value);
+    if (index >= CONSTANTS_MAX) {
+        compile_error(line, "too many constants in one chunk");
+        return 0;
+    }
+    return (uint16_t)index;
+}
+
+static uint16_t identifier_constant(String* name, int line) {
+    // names are interned, so pointer comparison is enough
+    Chunk* chunk = current_chunk();
+    for (int i = 0; i < chunk->constant_count; ++i) {
+        if (IS_STRING(chunk->constants[i]) && AS_STRING(chunk->constants[i]) == name) {
+            return (uint16_t)i;
+        }
+    }
+    return make_constant(STRING_VALUE(name), line);
+}
+
+// name constant and inline cache of a global or member lookup
+static void emit_lookup(uint8_t instruction, String* name, int line) {
+    emit_byte(instruction, line);
+    emit_short(identifier_constant(name, line), line);
+    int cache = chunk_add_cache(current_chunk());
+    if (cache > UINT16_MAX) {
+        compile_error(line, "too many global lookups in one chunk");
+    }
+    emit_short((uint16_t)cache, line);
+}
+
+static void emit_constant(Value value, int line) {
+    emit_byte(OP_CONSTANT, line);
+    emit_short(make_constant(value, line), line);
+}
+
+static int emit_jump(uint8_t instruction, int line) {
+    emit_byte(instruction, line);
+    emit_short(0xffff, line);
+    return current_chunk()->count - 2;
+}
+
+static void patch_jump(int offset) {
+    int jump = current_chunk()->count - offset - 2;
+    if (jump > UINT16_MAX) {
+        compile_error(current_chunk()->lines[offset], "too much code to jump over");
+    }
+    current_chunk()->code[offset] = (jump >> 8) & 0xff;
+    current_chunk()->code[offset + 1] = jump & 0xff;
+}
+
+static void emit_loop(int loop_start, int line) {
+    emit_byte(OP_LOOP, line);
+    int offset = current_chunk()->count - loop_start + 2;
+    if (offset > UINT16_MAX) {
+        compile_error(line, "loop body too large");
+    }
+    emit_short((uint16_t)offset, line);
+}
+
+static void init_compiler(Compiler* compiler, Function* function) {
+    compiler->enclosing = current;
+    compiler->function = function;
+    compiler->function->chunk = chunk_new();
+    compiler->local_count = 0;
+    compiler->scope_depth = 0;
+    compiler->loop = NULL;
+
+    // slot 0 holds called function
+    Local* local = &compiler->locals[compiler->local_count++];
+    local->name = NULL;
+    local->depth = 0;
+
+    current = compiler;
+}
+
+static Function* end_compiler(int line) {
+    emit_byte(OP_NULL, line);
+    emit_byte(OP_RETURN, line);
+    Function* function = current->function;
+    current = current->enclosing;
+    return function;
+}
+
+static void begin_scope() {
+    ++current->scope_depth;
+}
+
+static void end_scope(int line) {
+    --current->scope_depth;
+    while (current->local_count > 0 && current->locals[current->local_count - 1].depth > current->scope_depth) {
+        emit_byte(OP_POP, line);
+        --current->local_count;
+    }
+}
+
+static void declare_local(String* name, int line) {
+    for (int i = current->local_count - 1; i >= 0 && name != NULL; --i) {
+        Local* local = &current->locals[i];
+        if (local->depth < current->scope_depth) break;
+        if (local->name == name) {
+            compile_error(line, "redeclaration of variable '%s'", name->data);
+            return;
+        }
+    }
+    if (current->local_count == LOCALS_MAX) {
+        compile_error(line, "too many local variables in function");
+        return;
+    }
+    Local* local = &current->locals[current->local_count++];
+    local->name = name;
+    local->depth = current->scope_depth;
+}
+
+static int resolve_local(String* name) {
+    for (int i = current->local_count - 1; i >= 0; --i) {
+        if (current->locals[i].name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void emit_loop_exit(Loop* loop, int line) {
+    for (int i = current->local_count - 1; i >= loop->local_count; --i) {
+        emit_byte(OP_POP, line);
+    }
+}
+
+static void begin_loop(Loop* loop, int start) {
+    loop->enclosing = current->loop;
+    loop->start = start;
+    loop->local_count = current->local_count;
+    loop->breaks = NULL;
+    loop->break_count = 0;
+    loop->break_capacity = 0;
+    current->loop = loop;
+}
+
+static void end_loop(Loop* loop) {
+    for (int i = 0; i < loop->break_count; ++i) {
+        patch_jump(loop->breaks[i]);
+    }
+    free(loop->breaks);
+    current->loop = loop->enclosing;
+}
+
+static void compile(ASTNode* root);
+
+static void compile_variable_get(String* name, int line) {
+    int slot = resolve_local(name);
+    if (slot != -1) {
+        emit_bytes(OP_GET_LOCAL, (uint8_t)slot, line);
+    }
+    else {
+        emit_lookup(OP_GET_GLOBAL, name, line);
+    }
+}
+
+static void compile_variable_set(String* name, int line) {
+    int slot = resolve_local(name);
+    if (slot != -1) {
+        emit_bytes(OP_SET_LOCAL, (uint8_t)slot, line);
+    }
+    else {
+        emit_lookup(OP_SET_GLOBAL, name, line);
+    }
+}
+
+static void compile_function(ASTNodeFuncDecl* func_decl) {
+    int line = func_decl->base.line;
+    Compiler compiler;
+    init_compiler(&compiler, function_new(func_decl->name, func_decl->params, func_decl->param_count, func_decl->body));
+
+    begin_scope();
+    for (int i = 0; i < func_decl->param_count; ++i) {
+        declare_local(func_decl->params[i], line);
+    }
+    compile(func_decl->body);
+    Function* function = end_compiler(line);
+
+    emit_byte(OP_FUNCTION, line);
+    emit_short(make_constant(FUNCTION_VALUE(function), line), line);
+}
+
+static void compile_assignment(ASTNodeAssignment* assignment) {
+    int line = assignment->base.line;
+    if (assignment->target->type == AST_NODE_VAR) {
+        ASTNodeVar* target = (ASTNodeVar*)assignment->target;
+        if (assignment->op != TOKEN_EQUAL) {
+            compile_variable_get(target->name, line);
+        }
+        compile(assignment->value);
+        if (assignment->op != TOKEN_EQUAL) {
+            emit_bytes(OP_COMPOUND, (uint8_t)assignment->op, line);
+        }
+        compile_variable_set(target->name, line);
+    }
+    else {
+        ASTNodeSubscription* target = (ASTNodeSubscription*)assignment->target;
+        compile(target->expression);
+        compile(target->index);
+        if (assignment->op != TOKEN_EQUAL) {
+            emit_byte(OP_DUP2, line);
+            emit_byte(OP_GET_INDEX, line);
+        }
+        compile(assignment->value);
+        if (assignment->op != TOKEN_EQUAL) {
+            emit_bytes(OP_COMPOUND, (uint8_t)assignment->op, line);
+        }
+        emit_byte(OP_SET_INDEX, line);
+    }
+}
+
+static void compile_binary(ASTNodeBinary* binary) {
+    int line = binary->base.line;
+    compile(binary->left);
+    compile(binary->right);
+    switch (binary->op) {
+        case TOKEN_EQUAL_EQUAL:   emit_byte(OP_EQUAL, line); break;
+        case TOKEN_NOT_EQUAL:     emit_byte(OP_NOT_EQUAL, line); break;
+        case TOKEN_GREATER:       emit_byte(OP_GREATER, line); break;
+        case TOKEN_GREATER_EQUAL: emit_byte(OP_GREATER_EQUAL, line); break;
+        case TOKEN_LESS:          emit_byte(OP_LESS, line); break;
+        case TOKEN_LESS_EQUAL:    emit_byte(OP_LESS_EQUAL, line); break;
+        case TOKEN_PLUS:          emit_byte(OP_ADD, line); break;
+        case TOKEN_MINUS:         emit_byte(OP_SUBTRACT, line); break;
+        case TOKEN_ASTERISK:      emit_byte(OP_MULTIPLY, line); break;
+        case TOKEN_SLASH:         emit_byte(OP_DIVIDE, line); break;
+        case TOKEN_PERCENT:       emit_byte(OP_MODULO, line); break;
+        default: compile_error(line, "unknown binary operator '%s'", token_as_cstr(binary->op)); break;
+    }
+}
+
+// iteration state takes three hidden locals followed by loop variable: list or map, index of next
+// element or entry and null, or number of remaining integers, next integer and step for range
+static void compile_for_in(ASTNodeForInStmt* for_in) {
+    int line = for_in->base.line;
+    begin_scope();
+
+    ASTNodeCall* call = (ASTNodeCall*)for_in->iterable;
+    if (call->base.type == AST_NODE_CALL && call->callee->type == AST_NODE_VAR && call->count <= UINT8_MAX) {
+        // callee is known to be native range only at runtime
+        compile(call->callee);
+        for (int i = 0; i < call->count; ++i) {
+            compile(call->arguments[i]);
+        }
+        emit_bytes(OP_RANGE, (uint8_t)call->count, line);
+        emit_bytes(OP_CALL, (uint8_t)call->count, line);
+    }
+    else {
+        compile(for_in->iterable);
+    }
+    emit_byte(OP_ITERATOR, line);
+    int state_slot = current->local_count;
+    for (int i = 0; i < 3; ++i) {
+        declare_local(NULL, line);
+    }
+    emit_byte(OP_NULL, line);
+    declare_local(for_in->name, line);
+
+    Loop loop;
+    int loop_start = current_chunk()->count;
+    begin_loop(&loop, loop_start);
+    emit_bytes(OP_FOR_IN, (uint8_t)state_slot, line);
+    emit_short(0xffff, line);
+    int exit_jump = current_chunk()->count - 2;
+    if (for_in->body != NULL) {
+        compile(for_in->body);
+    }
+    emit_loop(loop_start, line);
+
+    patch_jump(exit_jump);
+    end_loop(&loop);
+    end_scope(line);
+}
+
+// op is OP_CALL, or OP_TAIL_CALL for call that is returned
+static void compile_call(ASTNodeCall* call, OpCode op) {
+    int line = call->base.line;
+    if (call->count > UINT8_MAX) {
+        compile_error(line, "cannot pass more than %d arguments", UINT8_MAX);
+    }
+    compile(call->callee);
+    for (int i = 0; i < call->count; ++i) {
+        compile(call->arguments[i]);
+    }
+    emit_bytes(op, (uint8_t)call->count, line);
+}
+
+static void compile(ASTNode* root) {
+    int line = root->line;
+
+    switch (root->type) {
+        case AST_NODE_PROGRAM:
+        case AST_NODE_BLOCK: {
+            ASTNodeBlock* block = (ASTNodeBlock*)root;
+            if (root->type == AST_NODE_BLOCK) begin_scope();
+            for (int i = 0; i < block->count; ++i) {
+                compile(block->statements[i]);
+            }
+            if (root->type == AST_NODE_BLOCK) end_scope(line);
+        } break;
+        case AST_NODE_IMPORT: {
+            ASTNodeImport* import = (ASTNodeImport*)root;
+            emit_byte(OP_IMPORT, line);
+            emit_short(identifier_constant(import->path, line), line);
+            emit_short(identifier_constant(import->name != NULL ? import->name : import->path, line), line);
+            if (import->name == NULL) {
+                emit_byte(OP_POP, line);
+            }
+            else if (current->scope_depth > 0) {
+                declare_local(import->name, line);
+            }
+            else {
+                emit_byte(OP_DEFINE_GLOBAL, line);
+                emit_short(identifier_constant(import->name, line), line);
+            }
+        } break;
+        case AST_NODE_FUNC_DECL: {
+            compile_function((ASTNodeFuncDecl*)root);
+        } break;
+        case AST_NODE_VAR_DECL: {
+            ASTNodeVarDecl* var_decl = (ASTNodeVarDecl*)root;
+            if (var_decl->initializer != NULL) {
+                compile(var_decl->initializer);
+            }
+            else {
+                emit_byte(OP_NULL, line);
+            }
+            if (current->scope_depth > 0) {
+                declare_local(var_decl->name, line);
+            }
+            else {
+                emit_byte(OP_DEFINE_GLOBAL, line);
+                emit_short(identifier_constant(var_decl->name, line), line);
+            }
+        } break;
+        case AST_NODE_EXPR_STMT: {
+            ASTNodeExprStmt* expr_stmt = (ASTNodeExprStmt*)root;
+            compile(expr_stmt->expression);
+            emit_byte(OP_POP, line);
+        } break;
+        case AST_NODE_TERNARY:
+        case AST_NODE_IF_STMT: {
+            ASTNodeIfStmt* if_stmt = (ASTNodeIfStmt*)root;
+            compile(if_stmt->condition);
+            int then_jump = emit_jump(OP_JUMP_IF_FALSE, line);
+            emit_byte(OP_POP, line);
+            compile(if_stmt->then_branch);
+            int else_jump = emit_jump(OP_JUMP, line);
+            patch_jump(then_jump);
+            emit_byte(OP_POP, line);
+            if (if_stmt->else_branch != NULL) {
+                compile(if_stmt->else_branch);
+            }
+            patch_jump(else_jump);
+        } break;
+        case AST_NODE_WHILE_STMT: {
+            ASTNodeWhileStmt* while_stmt = (ASTNodeWhileStmt*)root;
+            Loop loop;
+            int loop_start = current_chunk()->count;
+            begin_loop(&loop, loop_start);
+
+            compile(while_stmt->condition);
+            int exit_jump = emit_jump(OP_JUMP_IF_FALSE, line);
+            emit_byte(OP_POP, line);
+            if (while_stmt->body != NULL) {
+                compile(while_stmt->body);
+            }
+            emit_loop(loop_start, line);
+
+            patch_jump(exit_jump);
+            emit_byte(OP_POP, line);
+            end_loop(&loop);
+        } break;
+        case AST_NODE_FOR_STMT: {
+            ASTNodeForStmt* for_stmt = (ASTNodeForStmt*)root;
+            begin_scope();
+            if (for_stmt->initializer != NULL) {
+                compile(for_stmt->initializer);
+            }
+
+            int condition_start = current_chunk()->count;
+            compile(for_stmt->condition);
+            int exit_jump = emit_jump(OP_JUMP_IF_FALSE, line);
+            emit_byte(OP_POP, line);
+
+            // increment is placed before body, so 'continue' can jump back to it
+            int body_jump = emit_jump(OP_JUMP, line);
+            int increment_start = current_chunk()->count;
+            if (for_stmt->increment != NULL) {
+                compile(for_stmt->increment);
+                emit_byte(OP_POP, line);
+            }
+            emit_loop(condition_start, line);
+            patch_jump(body_jump);
+
+            Loop loop;
+            begin_loop(&loop, increment_start);
+            if (for_stmt->body != NULL) {
+                compile(for_stmt->body);
+            }
+            emit_loop(increment_start, line);
+
+            patch_jump(exit_jump);
+            emit_byte(OP_POP, line);
+            end_loop(&loop);
+            end_scope(line);
+        } break;
+        case AST_NODE_FOR_IN_STMT: {
+            compile_for_in((ASTNodeForInStmt*)root);
+        } break;
+        case AST_NODE_RETURN_STMT: {
+            ASTNodeExprStmt* return_stmt = (ASTNodeExprStmt*)root;
+            if (current->enclosing == NULL) {
+                compile_error(line, "'return' is only allowed inside functions");
+            }
+            if (return_stmt->expression != NULL && return_stmt->expression->type == AST_NODE_CALL) {
+                compile_call((ASTNodeCall*)return_stmt->expression, OP_TAIL_CALL);
+            }
+            else if (return_stmt->expression != NULL) {
+                compile(return_stmt->expression);
+            }
+            else {
+                emit_byte(OP_NULL, line);
+            }
+            emit_byte(OP_RETURN, line);
+        } break;
+        case AST_NODE_BREAK: {
+            Loop* loop = current->loop;
+            if (loop == NULL) {
+                compile_error(line, "'break' is only allowed inside loops");
+                break;
+            }
+            emit_loop_exit(loop, line);
+            if (loop->break_capacity < loop->break_count + 1) {
+                loop->break_capacity = GROW_CAPACITY(loop->break_capacity);
+                loop->breaks = GROW_ARRAY(int, loop->breaks, loop->break_capacity);
+            }
+            loop->breaks[loop->break_count++] = emit_jump(OP_JUMP, line);
+        } break;
+        case AST_NODE_CONTINUE: {
+            Loop* loop = current->loop;
+            if (loop == NULL) {
+                compile_error(line, "'continue' is only allowed inside loops");
+                break;
+            }
+            emit_loop_exit(loop, line);
+            emit_loop(loop->start, line);
+        } break;
+        case AST_NODE_ASSIGNMENT: {
+            compile_assignment((ASTNodeAssignment*)root);
+        } break;
+        case AST_NODE_LOGICAL: {
+            ASTNodeBinary* logical = (ASTNodeBinary*)root;
+            compile(logical->left);
+            if (logical->op == TOKEN_AND) {
+                int end_jump = emit_jump(OP_JUMP_IF_FALSE, line);
+                emit_byte(OP_POP, line);
+                compile(logical->right);
+                patch_jump(end_jump);
+            }
+            else {
+                int else_jump = emit_jump(OP_JUMP_IF_FALSE, line);
+                int end_jump = emit_jump(OP_JUMP, line);
+                patch_jump(else_jump);
+                emit_byte(OP_POP, line);
+                compile(logical->right);
+                patch_jump(end_jump);
+            }
+        } break;
+        case AST_NODE_BINARY: {
+            compile_binary((ASTNodeBinary*)root);
+        } break;
+        case AST_NODE_UNARY: {
+            ASTNodeUnary* unary = (ASTNodeUnary*)root;
+            compile(unary->right);
+            emit_byte(unary->op == TOKEN_MINUS ? OP_NEGATE : OP_NOT, line);
+        } break;
+        case AST_NODE_CALL: {
+            compile_call((ASTNodeCall*)root, OP_CALL);
+        } break;
+        case AST_NODE_GET: {
+            ASTNodeGet* get = (ASTNodeGet*)root;
+            compile(get->object);
+            emit_lookup(OP_GET_PROPERTY, get->name, line);
+        } break;
+        case AST_NODE_SUBSCRIPTION: {
+            ASTNodeSubscription* subscription = (ASTNodeSubscription*)root;
+            compile(subscription->expression);
+            compile(subscription->index);
+            emit_byte(OP_GET_INDEX, line);
+        } break;
+        case AST_NODE_LITERAL: {
+            ASTNodeLiteral* literal = (ASTNodeLiteral*)root;
+            switch (VALUE_TYPE(literal->value)) {
+                case VALUE_NULL: emit_byte(OP_NULL, line); break;
+                case VALUE_BOOL: emit_byte(AS_BOOL(literal->value) ? OP_TRUE : OP_FALSE, line); break;
+                default:         emit_constant(literal->value, line); break;
+            }
+        } break;
+        case AST_NODE_VAR: {
+            ASTNodeVar* var = (ASTNodeVar*)root;
+            compile_variable_get(var->name, line);
+        } break;
+        case AST_NODE_LIST: {
+            ASTNodeList* list = (ASTNodeList*)root;
+            emit_byte(OP_LIST, line);
+            emit_short(list->count > UINT16_MAX ? UINT16_MAX : (uint16_t)list->count, line);
+            for (int i = 0; i < list->count; ++i) {
+                compile(list->expressions[i]);
+                emit_byte(OP_LIST_APPEND, line);
+            }
+        } break;
+        case AST_NODE_MAP: {
+            ASTNodeMap* map = (ASTNodeMap*)root;
+            emit_byte(OP_MAP, line);
+            emit_short(map->count > UINT16_MAX ? UINT16_MAX : (uint16_t)map->count, line);
+            for (int i = 0; i < map->count; ++i) {
+                compile(map->keys[i]);
+                compile(map->values[i]);
+                emit_byte(OP_MAP_INSERT, line);
+            }
+        } break;
+    }
+}
+
+Function* compiler_compile(ASTNode* root) {
+    had_error = false;
+
+    // functions and constants referenced by bytecode must outlive any garbage collection
+    gc_pin_begin();
+    Compiler compiler;
+    init_compiler(&compiler, function_new(string_from("<script>"), NULL, 0, root));
+    compile(root);
+    Function* function = end_compiler(root->line);
+    gc_pin_end();
+
+    return had_error ? NULL : function;
+}
@@ -89,6 +89,16 @@ void debug_print_ast(ASTNode* root, int indent) {
                 debug_print_ast(for_stmt->body, indent + 1);
             }
         } break;
+        case AST_NODE_FOR_IN_STMT: {
+            ASTNodeForInStmt* for_in = (ASTNodeForInStmt*)root;
+            printf("ForIn: %s\n", for_in->name->data);
+            debug_print_ast(for_in->iterable, indent + 1);
+            if (for_in->body != NULL) {
+                for (int i = 0; i < indent; ++i) printf("  ");
+                printf("Then:\n");
+                debug_print_ast(for_in->body, indent + 1);
+            }
+        } break;
         case AST_NODE_RETURN_STMT: {
             ASTNodeExprStmt* return_stmt = (ASTNodeExprStmt*)root;
             printf("Return:");
@@ -159,7 +169,7 @@ void debug_print_ast(ASTNode* root, int indent) {
         case AST_NODE_LITERAL: {
             ASTNodeLiteral* literal = (ASTNodeLiteral*)root;
             fputs("Literal: ", stdout);
-            if (literal->value.type == VALUE_STRING) {
+            if (VALUE_TYPE(literal->value) == VALUE_STRING) {
                 putchar('"');
                 print_value(literal->value);
                 putchar('"');
@@ -171,7 +181,12 @@ void debug_print_ast(ASTNode* root, int indent) {
         } break;
         case AST_NODE_VAR: {
             ASTNodeVar* var = (ASTNodeVar*)root;
-            printf("Variable: %s\n", var->name->data);
+            if (var->slot >= 0) {
+                printf("Variable: %s (slot %d)\n", var->name->data, var->slot);
+            }
+            else {
+                printf("Variable: %s\n", var->name->data);
+            }
         } break;
         case AST_NODE_LIST: {
             ASTNodeList* list = (ASTNodeList*)root;
@@ -180,6 +195,14 @@ void debug_print_ast(ASTNode* root, int indent) {
                 debug_print_ast(list->expressions[i], indent + 1);
             }
         } break;
+        case AST_NODE_MAP: {
+            ASTNodeMap* map = (ASTNodeMap*)root;
+            printf("Map: %d\n", map->count);
+            for (int i = 0; i < map->count; ++i) {
+                debug_print_ast(map->keys[i], indent + 1);
+                debug_print_ast(map->values[i], indent + 2);
+            }
+        } break;
         default: {
             fprintf(stderr, "Unknown: ID=%d\n", root->type);
         } break;
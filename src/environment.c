@@ -1,27 +1,32 @@
 #include <stdlib.h>
 #include "environment.h"
 #include "hashmap.h"
+#include "memory.h"
+
+static uint32_t versions = 0;  // last version stamp given to an environment
 
 Environment* env_new() {
-    Environment* new_env = malloc(sizeof(Environment));
-    new_env->enclosing = NULL;
-    new_env->map = hashmap_create();
+    return env_new_with_enclosing(NULL);
+}
+
+static Environment* env_allocate(Environment* enclosing, HashMap map) {
+    Environment* new_env = (Environment*)gc_allocate(sizeof(Environment), OBJ_ENVIRONMENT);
+    new_env->enclosing = enclosing;
+    new_env->map = map;
+    new_env->version = ++versions;
     return new_env;
 }
 
 Environment* env_new_with_enclosing(Environment* env) {
-    Environment* new_env = malloc(sizeof(Environment));
-    new_env->enclosing = env;
-    new_env->map = hashmap_create();
-    return new_env;
+    return env_allocate(env, hashmap_create());
 }
 
-void env_free(Environment* env) {
-    hashmap_free(&env->map);
-    free(env);
+Environment* env_new_sized(Environment* env, int count) {
+    return env_allocate(env, hashmap_create_sized(count));
 }
 
 bool env_define(Environment* env, String* name, Value value) {
+    env->version = ++versions;
     return hashmap_put(&env->map, name, value);
 }
 
@@ -37,3 +42,22 @@ Value* env_get_ref(Environment* env, String* name) {
 
     return NULL;
 }
+
+Value* env_get_and_cache(Environment* env, String* name, EnvCache* cache) {
+    Environment* holder = env;
+    int depth = 0;
+    Value* ref = NULL;
+    for (; holder != NULL; holder = holder->enclosing, ++depth) {
+        ref = hashmap_get_ref(&holder->map, name);
+        if (ref != NULL) break;
+    }
+    // environments in between are not checked on hits, so only nearest two are cached
+    if (ref != NULL && depth <= 1) {
+        cache->env = env;
+        cache->holder = holder;
+        cache->env_version = env->version;
+        cache->holder_version = holder->version;
+        cache->ref = ref;
+    }
+    return ref;
+}
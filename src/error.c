@@ -0,0 +1,17 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "error.h"
+
+int current_line = 0;
+
+void runtime_error(const char* format, ...) {
+    fprintf(stderr, "[line %d] runtime error: ", current_line);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputs("\n", stderr);
+
+    exit(1);
+}
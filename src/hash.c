@@ -1,9 +1,9 @@
 #include "hash.h"
 #include "value.h"
 
-Hash hash_cstring(const char* cstring, int length) {
+Hash hash_cstring(const char* cstring, size_t length) {
     Hash hash = 2166136261u;
-    for (int i = 0; i < length; i++) {
+    for (size_t i = 0; i < length; i++) {
         hash ^= (uint8_t)cstring[i];
         hash *= 16777619;
     }
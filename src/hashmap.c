@@ -1,5 +1,4 @@
 #include <stdlib.h>
-#include <string.h>
 #include "hashmap.h"
 
 static void hashmap_resize(HashMap* map, int new_capacity) {
@@ -8,10 +7,10 @@ static void hashmap_resize(HashMap* map, int new_capacity) {
     for (int i = 0; i < map->capacity; ++i) {
         HashEntry entry = map->entries[i];
         if (entry.key != NULL) {
-            int index = entry.key->hash % new_capacity;
+            int index = entry.key->hash & (new_capacity - 1);
 
             while (new_entries[index].key != NULL) {
-                index = (index + 1) % new_capacity;
+                index = (index + 1) & (new_capacity - 1);
             }
 
             new_entries[index] = entry;
@@ -31,6 +30,18 @@ HashMap hashmap_create() {
     };
 }
 
+HashMap hashmap_create_sized(int count) {
+    int capacity = 1;
+    while (count > capacity * HASHMAP_LOAD_FACTOR) {
+        capacity *= 2;
+    }
+    return (HashMap){
+        .entries = calloc(capacity, sizeof(HashEntry)),
+        .capacity = capacity,
+        .count = 0
+    };
+}
+
 void hashmap_free(HashMap* map) {
     free(map->entries);
     map->entries = NULL;
@@ -43,15 +54,16 @@ bool hashmap_put(HashMap* map, String* key, Value value) {
         hashmap_resize(map, map->capacity * 2);
     }
 
-    int index = key->hash % map->capacity;
+    int index = key->hash & (map->capacity - 1);
 
+    // keys are interned, so the same string is always the same pointer
     while (map->entries[index].key != NULL) {
-        if (map->entries[index].key->length == key->length && strcmp(map->entries[index].key->data, key->data) == 0) {
+        if (map->entries[index].key == key) {
             // key exists, update value
             map->entries[index].value = value;
             return true;
         }
-        index = (index + 1) % map->capacity;
+        index = (index + 1) & (map->capacity - 1);
     }
 
     // insert new key-value pair
@@ -62,13 +74,13 @@ bool hashmap_put(HashMap* map, String* key, Value value) {
 }
 
 Value* hashmap_get_ref(HashMap* map, String* key) {
-    int index = key->hash % map->capacity;
+    int index = key->hash & (map->capacity - 1);
 
     while (map->entries[index].key != NULL) {
-        if (map->entries[index].key->length == key->length && strcmp(map->entries[index].key->data, key->data) == 0) {
+        if (map->entries[index].key == key) {
             return &map->entries[index].value;
         }
-        index = (index + 1) % map->capacity;
+        index = (index + 1) & (map->capacity - 1);
     }
 
     return NULL;
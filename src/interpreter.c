@@ -1,28 +1,39 @@
-#include <setjmp.h>
-#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
+#include "arena.h"
+#include "astcache.h"
 #include "environment.h"
+#include "error.h"
 #include "interpreter.h"
 #include "io.h"
 #include "lexer.h"
+#include "map.h"
 #include "memory.h"
+#include "natives.h"
+#include "operators.h"
 #include "parser.h"
+#include "profiler.h"
+#include "strings.h"
 #include "value.h"
 
-static int current_line = 0;
+#define STACK_MAX (1024 * 256)
+#define CALLS_MAX 1024  // nested calls recurse in C, top level counts as one like frame of VM
+
 static Environment* natives_scope = NULL;  // natives, present in all modules
+static Environment* main_scope    = NULL;  // globals of main program
 static Environment* global_scope  = NULL;  // globals present in current module
-static Environment* current_scope = NULL;  // currently interpreted scope in current module
 
-typedef enum {
-    CTX_OTHER,
-    CTX_FUNCTION,
-    CTX_LOOP,
-} ContextType;
+// imported modules are parsed here, their functions may be called until interpretation ends
+static Arena modules_arena;
+static HashMap modules;  // canonical path of imported file -> module
+
+static Value stack[STACK_MAX];     // locals of all active calls and blocks, and temporaries visible to GC
+static Value* stack_top = stack;   // first free slot
+static Value* frame_base = stack;  // slot 0 of currently interpreted call frame
+static int call_depth = 0;         // active function calls, tail calls reuse caller's
 
+// completion status of executed statement, propagated up to enclosing loop or call
 typedef enum {
     FLOW_NORMAL,
     FLOW_RETURN,
@@ -30,311 +41,229 @@ typedef enum {
     FLOW_CONTINUE,
 } FlowSignal;
 
-typedef struct ControlContext {
-    jmp_buf buf;
-    ContextType type;
-    FlowSignal signal;
-    struct ControlContext* parent;
-} ControlContext;
-
-static ControlContext* current_context = NULL;
-static Value ctx_return_value = NULL_VALUE();
-
-static bool is_truthy(Value value) {
-    switch (value.type) {
-        case VALUE_NULL:   return false;
-        case VALUE_INT: return value.integer != 0;
-        case VALUE_FLOAT: return value.floating != 0.0;
-        case VALUE_BOOL:   return value.boolean;
-        case VALUE_STRING: return value.string->length != 0;
-        case VALUE_LIST:   return value.list->length != 0;
-        case VALUE_NATIVE: return true;
-        case VALUE_FUNCTION: return true;
-        case VALUE_MODULE: return true;
-    }
-    return false;
-}
-
-static void runtime_error(const char* format, ...) {
-    fprintf(stderr, "[line %d] runtime error: ", current_line);
-    va_list args;
-    va_start(args, format);
-    vfprintf(stderr, format, args);
-    va_end(args);
-    fputs("\n", stderr);
+static Value return_value = NULL_VALUE();  // value of last executed 'return'
 
-    exit(1);
-}
+// Set by 'return' of a function call, which is made by caller of returning function in
+// place of its frame, so tail calls don't grow C or value stack. Callee and arguments are
+// left above top of the stack, nothing is pushed there before the call is made.
+static Value* tail_call = NULL;
+static int tail_call_count = 0;
 
-static Value clock_native(int argc, Value* argv) {
-    (void)argv;
-    if (argc != 0) runtime_error("expected 0 arguments but got %d", argc);
-    return FLOAT_VALUE((double)clock() / CLOCKS_PER_SEC);
-}
+static Value evaluate(ASTNode* root);
+static FlowSignal execute(ASTNode* root);
 
-static Value print_native(int argc, Value* argv) {
-    for (int i = 0; i < argc; ++i) {
-        print_value(argv[i]);
+static void reserve_slots(int count) {
+    if (stack_top + count > stack + STACK_MAX) {
+        runtime_error("stack overflow");
     }
-    fputc('\n', stdout);
-    return NULL_VALUE();
-}
-
-static Value input_native(int argc, Value* argv) {
-    if (argc > 1) runtime_error("expected 0 or 1 argument but got %d", argc);
-    else if (argc == 1) print_value(argv[0]);
-    char buffer[1024];
-    if (fgets(buffer, sizeof(buffer), stdin) != NULL) {
-        buffer[strcspn(buffer, "\n")] = '\0';
-        return STRING_VALUE(string_from(buffer));
+    // slots are visible to GC before variables are declared
+    for (int i = 0; i < count; ++i) {
+        stack_top[i] = NULL_VALUE();
     }
-    runtime_error("failed to read from input");
-    return NULL_VALUE();
-}
-
-static Value typeof_native(int argc, Value* argv) {
-    if (argc != 1) runtime_error("expected 1 argument but got %d", argc);
-    return STRING_VALUE(string_from(value_type_as_cstr(argv[0].type)));
+    stack_top += count;
 }
 
-static Value int_native(int argc, Value* argv) {
-    if (argc != 1) runtime_error("expected 1 argument but got %d", argc);
-    Value arg = argv[0];
-    switch (arg.type) {
-        case VALUE_NULL:   return INT_VALUE(0);
-        case VALUE_INT:    return arg;
-        case VALUE_FLOAT:  return INT_VALUE((int64_t)arg.floating);
-        case VALUE_BOOL:   return INT_VALUE(arg.boolean ? 1 : 0);
-        case VALUE_STRING: return INT_VALUE(strtoll(arg.string->data, NULL, 10));
-        default: runtime_error("cannot convert from %s to int", value_type_as_cstr(arg.type));
+static inline void push(Value value) {
+    if (stack_top == stack + STACK_MAX) {
+        runtime_error("stack overflow");
     }
-    return NULL_VALUE();
+    *stack_top++ = value;
 }
 
-static Value float_native(int argc, Value* argv) {
-    if (argc != 1) runtime_error("expected 1 argument but got %d", argc);
-    Value arg = argv[0];
-    switch (arg.type) {
-        case VALUE_NULL:   return FLOAT_VALUE(0.0);
-        case VALUE_INT:    return FLOAT_VALUE((double)arg.integer);
-        case VALUE_FLOAT:  return arg;
-        case VALUE_BOOL:   return FLOAT_VALUE(arg.boolean ? 1.0 : 0.0);
-        case VALUE_STRING: return FLOAT_VALUE(strtod(arg.string->data, NULL));
-        default: runtime_error("cannot convert from %s to float", value_type_as_cstr(arg.type));
+static Value* evaluate_variable(ASTNodeVar* var) {
+    if (var->slot >= 0) {
+        return &frame_base[var->slot];
     }
-    return NULL_VALUE();
+    Value* variable = env_get_cached(global_scope, var->name, &var->cache);
+    if (variable == NULL) {
+        runtime_error("undeclared identifier '%s'", var->name->data);
+    }
+    return variable;
 }
 
-static Value bool_native(int argc, Value* argv) {
-    if (argc != 1) runtime_error("expected 1 argument but got %d", argc);
-    Value arg = argv[0];
-    switch (arg.type) {
-        case VALUE_NULL:     return BOOL_VALUE(false);
-        case VALUE_INT:      return BOOL_VALUE(arg.integer != 0);
-        case VALUE_FLOAT:    return FLOAT_VALUE(arg.floating != 0.0);
-        case VALUE_BOOL:     return arg;
-        case VALUE_STRING:   return BOOL_VALUE(arg.string->length != 0);
-        case VALUE_NATIVE:   return BOOL_VALUE(true);
-        case VALUE_FUNCTION: return BOOL_VALUE(true);
-        default: runtime_error("cannot convert from %s to bool", value_type_as_cstr(arg.type));
-    }
-    return NULL_VALUE();
+// subscripted object and index are left on the stack, so they stay reachable while caller evaluates assigned value
+static Value* evaluate_subscription(ASTNodeSubscription* node) {
+    push(evaluate(node->expression));
+    push(evaluate(node->index));
+    return stack_top - 2;
 }
 
-static Value string_native(int argc, Value* argv) {
-    if (argc != 1) runtime_error("expected 1 argument but got %d", argc);
-    Value arg = argv[0];
-    switch (arg.type) {
-        case VALUE_NULL:   return STRING_VALUE(string_from("null"));
-        case VALUE_INT: {
-            char buffer[64];
-            snprintf(buffer, sizeof(buffer), "%ld", arg.integer);
-            return STRING_VALUE(string_from(buffer));
-        }
-        case VALUE_FLOAT: {
-            char buffer[64];
-            snprintf(buffer, sizeof(buffer), "%g", arg.floating);
-            return STRING_VALUE(string_from(buffer));
-        }
-        case VALUE_BOOL:   return STRING_VALUE(string_from(arg.boolean ? "true" : "false"));
-        case VALUE_STRING: return arg;
-        case VALUE_NATIVE: return STRING_VALUE(string_from("<native function>")); //TODO: also print name of function
-        case VALUE_FUNCTION: return STRING_VALUE(arg.function->name);
-        default: runtime_error("cannot convert from %s to string", value_type_as_cstr(arg.type));
+// call of native range is iterated without creating the list; false if callee is anything else
+static bool evaluate_range(ASTNode* node, int64_t* start, int64_t* step, int64_t* count) {
+    if (node->type != AST_NODE_CALL) return false;
+    ASTNodeCall* call = (ASTNodeCall*)node;
+    if (call->callee->type != AST_NODE_VAR) return false;
+    Value callee = *evaluate_variable((ASTNodeVar*)call->callee);
+    if (!natives_is_range(callee)) return false;
+
+    Value* arguments = stack_top;
+    for (int i = 0; i < call->count; ++i) {
+        push(evaluate(call->arguments[i]));
     }
-    return NULL_VALUE();
+    current_line = node->line;
+    natives_check_arity(AS_NATIVE(callee), call->count);
+    *count = natives_range_arguments(call->count, arguments, start, step);
+    stack_top = arguments;
+    return true;
 }
 
-static Value append_native(int argc, Value* argv) {
-    if (argc != 2) runtime_error("expected 2 arguments but got %d", argc);
-    Value list = argv[0];
-    Value value = argv[1];
+// each file is parsed and run only on its first import, later imports share its module
+static Value import_module(String* path, String* name) {
+    char* canonical_path = file_canonical_path(path->data);
+    String* key = intern_string(canonical_path, strlen(canonical_path));
+    free(canonical_path);
 
-    if (list.list->capacity < list.list->length + 1) {
-        list.list->capacity = GROW_CAPACITY(list.list->capacity);
-        list.list->values = GROW_ARRAY(Value, list.list->values, list.list->capacity);
+    Value* cached = hashmap_get_ref(&modules, key);
+    if (cached != NULL) {
+        return *cached;
     }
 
-    list.list->values[list.list->length++] = value;
-    return NULL_VALUE();
-}
+    push(STRING_VALUE(key));
+    ASTNode* imported_ast = NULL;
+    if (!astcache_parse_file(path->data, &modules_arena, &imported_ast)) {
+        runtime_error("there were errors during parsing imported module `%s`", path->data);
+    }
 
-static Value length_native(int argc, Value* argv) {
-    if (argc != 1) runtime_error("expected 1 argument but got %d", argc);
-    Value list = argv[0];
-    return INT_VALUE(list.list->length);
+    // module is registered before its code runs, so circular imports get the partially initialized one
+    Environment* this_global = global_scope;
+    Value* this_frame = frame_base;
+    global_scope = env_new_sized(natives_scope, ((ASTNodeBlock*)imported_ast)->local_count);
+    Value module = MODULE_VALUE(module_new(name, global_scope));
+    hashmap_put(&modules, key, module);
+    --stack_top;
+
+    frame_base = stack_top;
+    execute(imported_ast);
+    frame_base = this_frame;
+    global_scope = this_global;
+    return module;
 }
 
-static void add_natives() {
-    env_define(natives_scope, string_from("clock"), NATIVE_VALUE(clock_native));
-    env_define(natives_scope, string_from("print"), NATIVE_VALUE(print_native));
-    env_define(natives_scope, string_from("input"), NATIVE_VALUE(input_native));
-    env_define(natives_scope, string_from("typeof"), NATIVE_VALUE(typeof_native));
-
-    env_define(natives_scope, string_from("int"), NATIVE_VALUE(int_native));
-    env_define(natives_scope, string_from("float"), NATIVE_VALUE(float_native));
-    env_define(natives_scope, string_from("bool"), NATIVE_VALUE(bool_native));
-    env_define(natives_scope, string_from("string"), NATIVE_VALUE(string_native));
+// callee and arguments are kept on the stack, where GC can see them
+static Value evaluate_call(ASTNodeCall* call, Value callee) {
+    Value* callee_slot = stack_top;
+    push(callee);
+    if (VALUE_TYPE(callee) == VALUE_NATIVE) {
+        natives_check_arity(AS_NATIVE(callee), call->count);
+        for (int i = 0; i < call->count; ++i) {
+            push(evaluate(call->arguments[i]));
+        }
+        Value result = AS_NATIVE(callee)->function(call->count, callee_slot + 1);
+        stack_top = callee_slot;
+        return result;
+    }
+    if (VALUE_TYPE(callee) != VALUE_FUNCTION) {
+        runtime_error("attempt to call a non-function value");
+    }
 
-    env_define(natives_scope, string_from("append"), NATIVE_VALUE(append_native));
-    env_define(natives_scope, string_from("length"), NATIVE_VALUE(length_native));
-}
+    Function* function = AS_FUNCTION(callee);
+    if (function->param_count != call->count) {
+        runtime_error("expected %d arguments, but got %d", function->param_count, call->count);
+    }
+    Value* previous_base = frame_base;
+    Environment* previous_global = global_scope;
+    for (int i = 0; i < call->count; ++i) {
+        push(evaluate(call->arguments[i]));
+    }
+    if (++call_depth >= CALLS_MAX) {
+        runtime_error("stack overflow");
+    }
 
-static Value promote(Value value, ValueType target_type) {
-    Value result = { .type = target_type };
-    switch (target_type) {
-        case VALUE_INT: {
-            switch (value.type) {
-                case VALUE_INT:   return value;
-                case VALUE_FLOAT: result.integer = (int64_t)value.integer; break;
-                case VALUE_BOOL:  result.integer = value.boolean ? 1 : 0; break;
-                default: {
-                    runtime_error(
-                        "cannot promote value type from %s to %s",
-                        value_type_as_cstr(value.type),
-                        value_type_as_cstr(target_type)
-                    );
-                } break;
-            }
-        } break;
-        case VALUE_FLOAT: {
-            switch (value.type) {
-                case VALUE_INT:   result.floating = (double)value.integer; break;
-                case VALUE_FLOAT: return value;
-                case VALUE_BOOL:  result.floating = value.boolean ? 1.0 : 0.0; break;
-                default: {
-                    runtime_error(
-                        "cannot promote value type from %s to %s",
-                        value_type_as_cstr(value.type),
-                        value_type_as_cstr(target_type)
-                    );
-                } break;
-            }
-        } break;
-        case VALUE_BOOL: {
-            switch (value.type) {
-                case VALUE_INT:   result.boolean = value.integer != 0; break;
-                case VALUE_FLOAT: result.boolean = value.floating != 0.0; break;
-                case VALUE_BOOL:  return value;
-                default: {
-                    runtime_error(
-                        "cannot promote value type from %s to %s",
-                        value_type_as_cstr(value.type),
-                        value_type_as_cstr(target_type)
-                    );
-                } break;
-            }
-        } break;
-        default: {
-            runtime_error(
-                "cannot promote value type from %s to %s",
-                value_type_as_cstr(value.type),
-                value_type_as_cstr(target_type)
-            );
-        } break;
+    Value result = NULL_VALUE();
+    PROFILER_ENTER(function);
+    for (;;) {
+        frame_base = callee_slot + 1;
+        global_scope = function->globals;
+        if (execute(function->body) != FLOW_RETURN) break;
+        if (tail_call == NULL) {
+            result = return_value;
+            break;
+        }
+        memmove(callee_slot, tail_call, sizeof(Value) * (tail_call_count + 1));
+        stack_top = callee_slot + tail_call_count + 1;
+        tail_call = NULL;
+        function = AS_FUNCTION(*callee_slot);
+        PROFILER_LEAVE();
+        PROFILER_ENTER(function);
     }
+    PROFILER_LEAVE();
+
+    --call_depth;
+    stack_top = callee_slot;
+    frame_base = previous_base;
+    global_scope = previous_global;
     return result;
 }
 
-static Value evaluate(ASTNode* root);
+// call of function in 'return' is only prepared, see tail_call
+static FlowSignal execute_return(ASTNodeExprStmt* return_stmt) {
+    ASTNode* expression = return_stmt->expression;
+    if (expression == NULL || expression->type != AST_NODE_CALL) {
+        return_value = expression != NULL ? evaluate(expression) : NULL_VALUE();
+        return FLOW_RETURN;
+    }
 
-static Value* evaluate_subscription(ASTNodeSubscription* node) {
-    Value list = evaluate(node->expression);
-    if (!IS_LIST(list)) {
-        runtime_error("object is not subscriptable");
+    ASTNodeCall* call = (ASTNodeCall*)expression;
+    Value callee = evaluate(call->callee);
+    if (!IS_FUNCTION(callee)) {
+        return_value = evaluate_call(call, callee);
+        return FLOW_RETURN;
     }
-    Value index = evaluate(node->index);
-    if (!IS_INT(index)) {
-        runtime_error("list index must be an integer");
+    if (AS_FUNCTION(callee)->param_count != call->count) {
+        runtime_error("expected %d arguments, but got %d", AS_FUNCTION(callee)->param_count, call->count);
     }
-    int idx = (int)index.integer;
-    if (idx < 0 || idx >= list.list->length) {
-        runtime_error("index out of range");
+    Value* callee_slot = stack_top;
+    push(callee);
+    for (int i = 0; i < call->count; ++i) {
+        push(evaluate(call->arguments[i]));
     }
-    return &list.list->values[idx];
+    tail_call = callee_slot;
+    tail_call_count = call->count;
+    return FLOW_RETURN;
 }
 
-static Value evaluate(ASTNode* root) {
+static FlowSignal execute(ASTNode* root) {
     current_line = root->line;
+    PROFILER_POLL();
 
     switch (root->type) {
         case AST_NODE_PROGRAM: {
             ASTNodeBlock* block = (ASTNodeBlock*)root;
             for (int i = 0; i < block->count; ++i) {
-                evaluate(block->statements[i]);
+                execute(block->statements[i]);
             }
         } break;
         case AST_NODE_BLOCK: {
             ASTNodeBlock* block = (ASTNodeBlock*)root;
-            Environment* previous_scope = current_scope;
-            current_scope = env_new_with_enclosing(previous_scope);
-            for (int i = 0; i < block->count; ++i) {
-                evaluate(block->statements[i]);
+            Value* previous_top = stack_top;
+            if (block->local_count > 0) {  // most loop and if bodies declare nothing
+                reserve_slots(block->local_count);
             }
-            env_free(current_scope);
-            current_scope = previous_scope;
-        } break;
+            FlowSignal signal = FLOW_NORMAL;
+            for (int i = 0; i < block->count && signal == FLOW_NORMAL; ++i) {
+                signal = execute(block->statements[i]);
+            }
+            stack_top = previous_top;
+            return signal;
+        }
         case AST_NODE_IMPORT: {
             ASTNodeImport* import = (ASTNodeImport*)root;
-
-            Environment* this_global = global_scope;
-            Environment* this_current = current_scope;
-            
-            char* source = file_read(import->path->data);
-            ASTNode* imported_ast = NULL;
-
-            if (!parser_parse(source, &imported_ast)) {
-                runtime_error("there were errors during parsing imported module `%s`", import->path->data);
-            }
-
-            // create scopes for module, interpret imported module
-            global_scope = env_new_with_enclosing(natives_scope);
-            current_scope = global_scope;
-            evaluate(imported_ast);
+            Value module = import_module(import->path, import->name);
 
             if (import->name != NULL) {
-                // FIXME: module not freed
-                env_define(this_current, import->name, MODULE_VALUE(module_new(import->name, global_scope)));
+                if (import->slot >= 0) {
+                    frame_base[import->slot] = module;
+                }
+                else {
+                    env_define(global_scope, import->name, module);
+                }
             }
-
-            // TODO: functions and globals should not be freed from the module, because they can be used
-            // however, from now, pointer to this AST will be lost, so huge memory leak coming right up
-            // parser_free_ast(imported_ast);
-            free(source);
-
-            global_scope = this_global;
-            current_scope = this_current;
-
-            return NULL_VALUE();
         } break;
         case AST_NODE_FUNC_DECL: {
             ASTNodeFuncDecl* func_decl = (ASTNodeFuncDecl*)root;
-            Function* function = malloc(sizeof(Function));  // FIXME: not freed
             // TODO: name might not be needed in function value
-            function->name = func_decl->name;
-            function->params = func_decl->params;
-            function->param_count = func_decl->param_count;
-            function->body = func_decl->body;
+            Function* function = function_new(func_decl->name, func_decl->params, func_decl->param_count, func_decl->body);
+            function->globals = global_scope;
 
             env_define(global_scope, function->name, FUNCTION_VALUE(function));
         } break;
@@ -344,7 +273,10 @@ static Value evaluate(ASTNode* root) {
             if (var_decl->initializer != NULL) {
                 value = evaluate(var_decl->initializer);
             }
-            if (env_define(current_scope, var_decl->name, value)) {
+            if (var_decl->slot >= 0) {
+                frame_base[var_decl->slot] = value;
+            }
+            else if (env_define(global_scope, var_decl->name, value)) {
                 runtime_error("redeclaration of variable '%s'", var_decl->name->data);
             }
         } break;
@@ -355,115 +287,147 @@ static Value evaluate(ASTNode* root) {
         case AST_NODE_IF_STMT: {
             ASTNodeIfStmt* if_stmt = (ASTNodeIfStmt*)root;
             if (is_truthy(evaluate(if_stmt->condition))) {
-                evaluate(if_stmt->then_branch);
+                return execute(if_stmt->then_branch);
             }
-            else if (if_stmt->else_branch != NULL) {
-                evaluate(if_stmt->else_branch);
+            if (if_stmt->else_branch != NULL) {
+                return execute(if_stmt->else_branch);
             }
         } break;
         case AST_NODE_WHILE_STMT: {
             ASTNodeWhileStmt* while_stmt = (ASTNodeWhileStmt*)root;
-
-            ControlContext ctx = { 0 };
-            ctx.parent = current_context;
-            ctx.type = CTX_LOOP;
-            current_context = &ctx;
-
             while (is_truthy(evaluate(while_stmt->condition))) {
-                if (setjmp(ctx.buf) == 0) {
-                    if (while_stmt->body != NULL) {
-                        evaluate(while_stmt->body);
-                    }
-                }
-                else {
-                    FlowSignal sig = ctx.signal;
-                    if (sig == FLOW_BREAK) break;
-                    if (sig == FLOW_CONTINUE) continue;
-                }
+                if (while_stmt->body == NULL) continue;
+                FlowSignal signal = execute(while_stmt->body);
+                if (signal == FLOW_BREAK) break;
+                if (signal == FLOW_RETURN) return signal;
             }
-
-            current_context = ctx.parent;
         } break;
         case AST_NODE_FOR_STMT: {
             ASTNodeForStmt* for_stmt = (ASTNodeForStmt*)root;
 
-            Environment* previous_scope = current_scope;
-            current_scope = env_new_with_enclosing(previous_scope);
+            Value* previous_top = stack_top;
+            reserve_slots(for_stmt->local_count);
 
             if (for_stmt->initializer != NULL) {
-                evaluate(for_stmt->initializer);
+                execute(for_stmt->initializer);
             }
 
-            ControlContext ctx = { 0 };
-            ctx.parent = current_context;
-            ctx.type = CTX_LOOP;
-            current_context = &ctx;
-
+            FlowSignal signal = FLOW_NORMAL;
             while (is_truthy(evaluate(for_stmt->condition))) {
-                if (setjmp(ctx.buf) == 0) {
-                    if (for_stmt->body != NULL) {
-                        evaluate(for_stmt->body);
+                if (for_stmt->body != NULL) {
+                    signal = execute(for_stmt->body);
+                    if (signal == FLOW_BREAK || signal == FLOW_RETURN) break;
+                }
+                if (for_stmt->increment != NULL) {
+                    evaluate(for_stmt->increment);
+                }
+            }
+
+            stack_top = previous_top;
+            if (signal == FLOW_RETURN) return signal;
+        } break;
+        case AST_NODE_FOR_IN_STMT: {
+            ASTNodeForInStmt* for_in = (ASTNodeForInStmt*)root;
+            Value* previous_top = stack_top;
+            reserve_slots(2);
+
+            // loop variable is overwritten in its slot, iteration allocates nothing
+            FlowSignal signal = FLOW_NORMAL;
+            int64_t start, step, count;
+            if (evaluate_range(for_in->iterable, &start, &step, &count)) {
+                uint64_t value = (uint64_t)start;
+                for (int64_t i = 0; i < count; ++i) {
+                    frame_base[for_in->slot] = INT_VALUE((int64_t)value);
+                    value += (uint64_t)step;
+                    signal = execute(for_in->body);
+                    if (signal == FLOW_BREAK || signal == FLOW_RETURN) break;
+                }
+            }
+            else {
+                Value iterable = evaluate(for_in->iterable);
+                frame_base[for_in->slot - 1] = iterable;
+                if (IS_LIST(iterable)) {
+                    // body may change length of list
+                    List* list = AS_LIST(iterable);
+                    for (int i = 0; i < list->length; ++i) {
+                        frame_base[for_in->slot] = list_get(list, i);
+                        signal = execute(for_in->body);
+                        if (signal == FLOW_BREAK || signal == FLOW_RETURN) break;
                     }
-                    if (for_stmt->increment != NULL) {
-                        evaluate(for_stmt->increment);
+                }
+                else if (IS_MAP(iterable)) {
+                    // keys inserted while iterating may be skipped, if map grows they may repeat
+                    Map* map = AS_MAP(iterable);
+                    for (int i = map_next(map, 0); i >= 0; i = map_next(map, i + 1)) {
+                        frame_base[for_in->slot] = map->entries[i].key;
+                        signal = execute(for_in->body);
+                        if (signal == FLOW_BREAK || signal == FLOW_RETURN) break;
                     }
                 }
                 else {
-                    FlowSignal sig = ctx.signal;
-                    if (sig == FLOW_BREAK) break;
-                    if (sig == FLOW_CONTINUE) {
-                        if (for_stmt->increment != NULL) {
-                            evaluate(for_stmt->increment);
-                        }
-                        continue;   
-                    }
+                    runtime_error("object of type '%s' is not iterable", value_type_as_cstr(VALUE_TYPE(iterable)));
                 }
             }
 
-            env_free(current_scope);
-            current_scope = previous_scope;
+            stack_top = previous_top;
+            if (signal == FLOW_RETURN) return signal;
         } break;
-        case AST_NODE_RETURN_STMT: {
-            ASTNodeExprStmt* return_stmt = (ASTNodeExprStmt*)root;
-
-            if (current_context == NULL || current_context->type != CTX_FUNCTION) {
-                runtime_error("'return' is only allowed inside functions");
-            }
-
-            Value return_value = (return_stmt->expression != NULL) ? evaluate(return_stmt->expression) : NULL_VALUE();
-            ctx_return_value = return_value;
-            current_context->signal = FLOW_RETURN;
-            longjmp(current_context->buf, 1);
+        case AST_NODE_RETURN_STMT: return execute_return((ASTNodeExprStmt*)root);
+        case AST_NODE_BREAK: return FLOW_BREAK;
+        case AST_NODE_CONTINUE: return FLOW_CONTINUE;
+        default: {
+            evaluate(root);
         } break;
-        case AST_NODE_BREAK: {
-            if (current_context == NULL || current_context->type != CTX_LOOP) {
-                runtime_error("'break' is only allowed inside loops");
-            }
+    }
+    return FLOW_NORMAL;
+}
 
-            current_context->signal = FLOW_BREAK;
-            longjmp(current_context->buf, 1);
+// Node is specialised for operand types of its first evaluation and falls back to
+// generic operators for good once they change. False if generic operator has to run.
+static bool evaluate_quickened(Quickening* quickening, TokenType op, Value left, Value right, Value* result) {
+    switch (*quickening) {
+        case QUICK_INTS: {
+            if (IS_INT(left) && IS_INT(right)) return operator_ints(op, AS_INT(left), AS_INT(right), result);
         } break;
-        case AST_NODE_CONTINUE: {
-            if (current_context == NULL || current_context->type != CTX_LOOP) {
-                runtime_error("'break' is only allowed inside loops");
-            }
-
-            current_context->signal = FLOW_CONTINUE;
-            longjmp(current_context->buf, 1);
+        case QUICK_FLOATS: {
+            if (IS_FLOAT(left) && IS_FLOAT(right)) return operator_floats(op, AS_FLOAT(left), AS_FLOAT(right), result);
         } break;
+        case QUICK_GENERIC: return false;
+        case QUICK_NONE: {
+            if (IS_INT(left) && IS_INT(right)) *quickening = QUICK_INTS;
+            else if (IS_FLOAT(left) && IS_FLOAT(right)) *quickening = QUICK_FLOATS;
+            else break;
+            return evaluate_quickened(quickening, op, left, right, result);
+        }
+    }
+    *quickening = QUICK_GENERIC;
+    return false;
+}
+
+static Value evaluate(ASTNode* root) {
+    current_line = root->line;
+
+    switch (root->type) {
         case AST_NODE_ASSIGNMENT: {
             ASTNodeAssignment* assignment = (ASTNodeAssignment*)root;
-            Value* var = NULL;
-            if (assignment->target->type == AST_NODE_VAR) {
-                ASTNodeVar* target = (ASTNodeVar*)assignment->target;
-                var = env_get_ref(current_scope, target->name);
-                if (var == NULL) {
-                    runtime_error("undeclared identifier '%s'", target->name->data);
+            if (assignment->target->type == AST_NODE_SUBSCRIPTION) {
+                Value* operands = evaluate_subscription((ASTNodeSubscription*)assignment->target);
+                push(evaluate(assignment->value));
+                if (assignment->op != TOKEN_EQUAL) {
+                    Value target = operator_subscript_get(operands[0], operands[1]);
+                    Value result;
+                    if (!evaluate_quickened(&assignment->quickening, assignment->op, target, stack_top[-1], &result)) {
+                        result = operator_compound(assignment->op, target, stack_top[-1]);
+                    }
+                    stack_top[-1] = result;
                 }
+                Value value = stack_top[-1];
+                operator_subscript_set(operands[0], operands[1], value);
+                stack_top = operands;
+                return value;
             }
-            else if (assignment->target->type == AST_NODE_SUBSCRIPTION) {
-                var = evaluate_subscription((ASTNodeSubscription*)assignment->target);
-            }
+
+            Value* var = evaluate_variable((ASTNodeVar*)assignment->target);
             Value value = evaluate(assignment->value);
 
             if (assignment->op == TOKEN_EQUAL) {
@@ -471,61 +435,14 @@ static Value evaluate(ASTNode* root) {
                 return *var;
             }
 
-            if (assignment->op == TOKEN_PLUS_EQUAL && (var->type == VALUE_STRING || value.type == VALUE_STRING)) {
-                if (var->type == VALUE_STRING && value.type == VALUE_STRING) {
-                    var->string = string_concat(var->string, value.string);
-                    return *var;
-                }
-                runtime_error("string concatenation is only possible for two strings");
-            }
-
-            if (var->type < VALUE_INT || var->type > VALUE_BOOL || value.type < VALUE_INT || value.type > VALUE_BOOL) {
-                runtime_error(
-                    "cannot perform assignment operation '%s' for '%s' and '%s'",
-                    token_as_cstr(assignment->op),
-                    value_type_as_cstr(var->type),
-                    value_type_as_cstr(value.type)
-                );
-            }
-
-            ValueType result_type = VALUE_NULL;
-            if (var->type == VALUE_FLOAT || value.type == VALUE_FLOAT) result_type = VALUE_FLOAT;
-            else result_type = VALUE_INT;
-
-            *var = promote(*var, result_type);
-            value = promote(value, result_type);
-
-            switch(assignment->op) {
-                case TOKEN_PLUS_EQUAL: {
-                    if (result_type == VALUE_INT) var->integer += value.integer;
-                    else var->floating += value.floating;
-                } break;
-                case TOKEN_MINUS_EQUAL: {
-                    if (result_type == VALUE_INT) var->integer -= value.integer;
-                    else var->floating -= value.floating;
-                } break;
-                case TOKEN_ASTERISK_EQUAL: {
-                    if (result_type == VALUE_INT) var->integer *= value.integer;
-                    else var->floating *= value.floating;
-                } break;
-                case TOKEN_SLASH_EQUAL: {
-                    if (result_type == VALUE_INT) {
-                        if (value.integer == 0) runtime_error("division by zero");
-                        var->integer /= value.integer;
-                    }
-                    else {
-                        if (value.floating == 0.0) runtime_error("division by zero");
-                        var->floating /= value.floating;
-                    }
-                } break;
-                case TOKEN_PERCENT_EQUAL: {
-                    if (result_type != VALUE_INT) runtime_error("modulo operation is only allowed for integers");
-                    if (value.integer == 0) runtime_error("modulo by zero");
-                    var->integer %= value.integer;
-                }
-                default: break;
+            Value result;
+            if (!evaluate_quickened(&assignment->quickening, assignment->op, *var, value, &result)) {
+                push(value);
+                result = operator_compound(assignment->op, *var, value);
+                --stack_top;
             }
-            return *var;
+            *var = result;
+            return result;
         }
         case AST_NODE_TERNARY: {
             ASTNodeIfStmt* ternary = (ASTNodeIfStmt*)root;
@@ -550,221 +467,107 @@ static Value evaluate(ASTNode* root) {
         }
         case AST_NODE_BINARY: {
             ASTNodeBinary* binary = (ASTNodeBinary*)root;
-            Value left = evaluate(binary->left);
-            Value right = evaluate(binary->right);
-
-            if (binary->op == TOKEN_EQUAL_EQUAL) {
-                return BOOL_VALUE(values_equal(left, right));
-            }
-            if (binary->op == TOKEN_NOT_EQUAL) {
-                return BOOL_VALUE(!values_equal(left, right));
-            }
-
-            // ugly hack for string concatenation
-            if (binary->op == TOKEN_PLUS && (left.type == VALUE_STRING || right.type == VALUE_STRING)) {
-                if (left.type == VALUE_STRING && right.type == VALUE_STRING) {
-                    return STRING_VALUE(string_concat(left.string, right.string));
-                }
-                runtime_error("string concatenation is only possible for two strings");
-            }
-
-            if (left.type < VALUE_INT || left.type > VALUE_BOOL || right.type < VALUE_INT || right.type > VALUE_BOOL) {
-                runtime_error(
-                    "cannot perform binary operation '%s' for '%s' and '%s'",
-                    token_as_cstr(binary->op),
-                    value_type_as_cstr(left.type),
-                    value_type_as_cstr(right.type)
-                );
-            }
-
-            ValueType result_type = VALUE_NULL;
-            if (left.type == VALUE_FLOAT || right.type == VALUE_FLOAT) result_type = VALUE_FLOAT;
-            else if (left.type == VALUE_INT || right.type == VALUE_INT) result_type = VALUE_INT;
-            else result_type = VALUE_BOOL;
-
-            left = promote(left, result_type);
-            right = promote(right, result_type);
-
-            switch (binary->op) {
-                case TOKEN_PLUS: {
-                    if (result_type == VALUE_INT) return INT_VALUE(left.integer + right.integer);
-                    if (result_type == VALUE_FLOAT) return FLOAT_VALUE(left.floating + right.floating); 
-                    return INT_VALUE(left.boolean + right.boolean);
-                }
-                case TOKEN_MINUS: {
-                    if (result_type == VALUE_INT) return INT_VALUE(left.integer - right.integer);
-                    if (result_type == VALUE_FLOAT) return FLOAT_VALUE(left.floating - right.floating); 
-                    return INT_VALUE(left.boolean - right.boolean);
-                }
-                case TOKEN_ASTERISK: {
-                    if (result_type == VALUE_INT) return INT_VALUE(left.integer * right.integer);
-                    if (result_type == VALUE_FLOAT) return FLOAT_VALUE(left.floating * right.floating); 
-                    return INT_VALUE(left.boolean * right.boolean);
-                }
-                case TOKEN_SLASH: {
-                    if (result_type == VALUE_INT) {
-                        if (right.integer == 0) runtime_error("division by zero");
-                        return INT_VALUE(left.integer / right.integer);
-                    }
-                    if (result_type == VALUE_FLOAT) {
-                        if (right.floating == 0.0) runtime_error("division by zero");
-                        return FLOAT_VALUE(left.floating / right.floating);
-                    }
-                    if (right.boolean == false) runtime_error("division by zero");
-                    return INT_VALUE(left.boolean / right.boolean);
-                }
-                case TOKEN_PERCENT: {
-                    if (result_type != VALUE_INT) runtime_error("modulo operation is only allowed for integers");
-                    if (right.integer == 0) runtime_error("modulo by zero");
-                    return INT_VALUE(left.integer % right.integer);
-                }
-                case TOKEN_GREATER: {
-                    if (result_type == VALUE_INT) return BOOL_VALUE(left.integer > right.integer);
-                    if (result_type == VALUE_FLOAT) return BOOL_VALUE(left.floating > right.floating); 
-                    return BOOL_VALUE(left.boolean > right.boolean);
-                }
-                case TOKEN_GREATER_EQUAL: {
-                    if (result_type == VALUE_INT) return BOOL_VALUE(left.integer >= right.integer);
-                    if (result_type == VALUE_FLOAT) return BOOL_VALUE(left.floating >= right.floating); 
-                    return BOOL_VALUE(left.boolean >= right.boolean);
-                }
-                case TOKEN_LESS: {
-                    if (result_type == VALUE_INT) return BOOL_VALUE(left.integer < right.integer);
-                    if (result_type == VALUE_FLOAT) return BOOL_VALUE(left.floating < right.floating); 
-                    return BOOL_VALUE(left.boolean < right.boolean);
-                }
-                case TOKEN_LESS_EQUAL: {
-                    if (result_type == VALUE_INT) return BOOL_VALUE(left.integer <= right.integer);
-                    if (result_type == VALUE_FLOAT) return BOOL_VALUE(left.floating <= right.floating); 
-                    return BOOL_VALUE(left.boolean <= right.boolean);
-                }
-                default: break;
-            }
-        } break;
+            // operands stay on the stack, because concatenation links them into new string
+            push(evaluate(binary->left));
+            push(evaluate(binary->right));
+            Value result;
+            if (!evaluate_quickened(&binary->quickening, binary->op, stack_top[-2], stack_top[-1], &result)) {
+                result = operator_binary(binary->op, stack_top[-2], stack_top[-1]);
+            }
+            stack_top -= 2;
+            return result;
+        }
         case AST_NODE_UNARY: {
             ASTNodeUnary* unary = (ASTNodeUnary*)root;
-            Value value = evaluate(unary->right);
-
-            switch (unary->op) {
-                case TOKEN_MINUS: {
-                    if (value.type == VALUE_INT) value.integer = -value.integer;
-                    else if (value.type == VALUE_FLOAT) value.floating = -value.floating;
-                    else if (value.type == VALUE_BOOL) value = INT_VALUE(-value.boolean);
-                    else {
-                        runtime_error(
-                            "cannot perform unary operation '%s' for '%s'",
-                            token_as_cstr(TOKEN_MINUS),
-                            value_type_as_cstr(value.type)
-                        );
-                    }
-                    return value;
-                }
-                case TOKEN_NOT: {
-                    return BOOL_VALUE(!is_truthy(value));
-                }
-                default: break;
-            }
-            return NULL_VALUE();
+            return operator_unary(unary->op, evaluate(unary->right));
         }
         case AST_NODE_CALL: {
             ASTNodeCall* call = (ASTNodeCall*)root;
-            Value callee = evaluate(call->callee);
-
-            if (callee.type == VALUE_NATIVE) {
-                Value* args = malloc(sizeof(Value) * call->count);
-                for (int i = 0; i < call->count; ++i) {
-                    args[i] = evaluate(call->arguments[i]);
-                }
-                Value result = callee.native(call->count, args);
-                free(args);
-                return result;
-            }
-            if (callee.type == VALUE_FUNCTION) {
-                if (callee.function->param_count != call->count) {
-                    runtime_error("expected %d arguments, but got %d", callee.function->param_count, call->count);
-                }
-                Environment* previous_scope = current_scope;
-                Environment* func_scope = env_new_with_enclosing(global_scope);
-                for (int i = 0; i < call->count; ++i) {
-                    env_define(func_scope, callee.function->params[i], evaluate(call->arguments[i]));
-                }
-                current_scope = func_scope;
-
-                ControlContext ctx = { 0 };
-                ctx.parent = current_context;
-                ctx.type = CTX_FUNCTION;
-                current_context = &ctx;
-                Value return_value = NULL_VALUE();
-
-                if (setjmp(ctx.buf) == 0) {
-                    evaluate(callee.function->body);
-                }
-                else {
-                    FlowSignal sig = ctx.signal;
-                    if (sig == FLOW_RETURN) {
-                        return_value = ctx_return_value;
-                    }
-                }
-
-                current_context = ctx.parent;
-                free(func_scope);
-                current_scope = previous_scope;
-                return return_value;
-            }
-            else {
-                runtime_error("attempt to call a non-function value");
-            }
-        } break;
+            return evaluate_call(call, evaluate(call->callee));
+        }
         case AST_NODE_GET: {
             ASTNodeGet* get = (ASTNodeGet*)root;
             Value object_value = evaluate(get->object);
-            switch (object_value.type) {
+            switch (VALUE_TYPE(object_value)) {
                 case VALUE_MODULE: {
-                    return *env_get_ref(object_value.module->env, get->name);
+                    Module* module = AS_MODULE(object_value);
+                    Value* member = env_get_cached(module->env, get->name, &get->cache);
+                    if (member == NULL) {
+                        runtime_error("module '%s' has no member '%s'", module->name->data, get->name->data);
+                    }
+                    return *member;
                 }
                 default: {
-                    runtime_error("Object of type '%s' doesn't have properties", value_type_as_cstr(object_value.type));
+                    runtime_error("Object of type '%s' doesn't have properties", value_type_as_cstr(VALUE_TYPE(object_value)));
                 }
             }
             return NULL_VALUE();
         } break;
         case AST_NODE_SUBSCRIPTION: {
-            ASTNodeSubscription* subscription = (ASTNodeSubscription*)root;
-            return *evaluate_subscription(subscription);
+            Value* operands = evaluate_subscription((ASTNodeSubscription*)root);
+            Value value = operator_subscript_get(operands[0], operands[1]);
+            stack_top = operands;
+            return value;
         } break;
         case AST_NODE_LITERAL: {
             ASTNodeLiteral* literal = (ASTNodeLiteral*)root;
             return literal->value;
         }
         case AST_NODE_VAR: {
-            ASTNodeVar* var = (ASTNodeVar*)root;
-            Value* variable = env_get_ref(current_scope, var->name);
-            if (variable == NULL) {
-                runtime_error("undeclared identifier '%s'", var->name->data);
-            }
-            return *variable;
+            return *evaluate_variable((ASTNodeVar*)root);
         }
         case AST_NODE_LIST: {
             ASTNodeList* list_node = (ASTNodeList*)root;
             List* list = list_new(list_node->count);
-            list->length = list_node->count;
+            push(LIST_VALUE(list));
             for (int i = 0; i < list_node->count; ++i) {
-                list->values[i] = evaluate(list_node->expressions[i]);
+                list_append(list, evaluate(list_node->expressions[i]));
             }
+            --stack_top;
             return LIST_VALUE(list);
         }
+        case AST_NODE_MAP: {
+            ASTNodeMap* map_node = (ASTNodeMap*)root;
+            Map* map = map_new(map_node->count);
+            push(MAP_VALUE(map));
+            for (int i = 0; i < map_node->count; ++i) {
+                push(evaluate(map_node->keys[i]));
+                push(evaluate(map_node->values[i]));
+                map_set(map, map_key(stack_top[-2]), stack_top[-1]);
+                stack_top -= 2;
+            }
+            --stack_top;
+            return MAP_VALUE(map);
+        }
+        default: break;  // statements are handled by execute()
     }
     return NULL_VALUE();
 }
 
 Value interpreter_interpret(ASTNode* root) {
     natives_scope = env_new();
-    add_natives();
-
-    global_scope = env_new_with_enclosing(natives_scope);
-    current_scope = global_scope;
+    natives_define(natives_scope);
+
+    main_scope = env_new_sized(natives_scope, ((ASTNodeBlock*)root)->local_count);
+    global_scope = main_scope;
+    stack_top = frame_base = stack;
+    call_depth = 0;
+    arena_init(&modules_arena);
+    modules = hashmap_create();
+
+    execute(root);
+    hashmap_free(&modules);
+    arena_free(&modules_arena);
+    return NULL_VALUE();
+}
 
-    Value value = evaluate(root);
-    env_free(current_scope);
-    return value;
+void interpreter_mark_roots() {
+    for (Value* slot = stack; slot < stack_top; ++slot) {
+        gc_mark_value(*slot);
+    }
+    gc_mark_object((Obj*)natives_scope);
+    gc_mark_object((Obj*)main_scope);
+    gc_mark_object((Obj*)global_scope);
+    gc_mark_hashmap(&modules);
+    gc_mark_value(return_value);
 }
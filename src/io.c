@@ -1,28 +1,53 @@
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "io.h"
 
-char* file_read(const char* file_path) {
-    FILE* file = fopen(file_path, "rb");
-    if (file == NULL) {
-        fprintf(stderr, "io::file_read: failed to open file: %s\n", file_path);
+MappedFile file_map(const char* file_path) {
+    int descriptor = open(file_path, O_RDONLY);
+    if (descriptor < 0) {
+        fprintf(stderr, "io::file_map: failed to open file: %s\n", file_path);
         exit(1);
     }
 
-    fseek(file, 0, SEEK_END);
-    int length = ftell(file);
-    rewind(file);
-
-    char* content = (char*)malloc(sizeof(char) * length + 1);
-    if (content == NULL) {
-        fprintf(stderr, "io::file_read: failed to allocate memory for file: %s\n", file_path);
+    struct stat info;
+    if (fstat(descriptor, &info) != 0 || !S_ISREG(info.st_mode)) {
+        fprintf(stderr, "io::file_map: not a regular file: %s\n", file_path);
         exit(1);
     }
 
-    fread(content, 1, length, file);
-    content[length] = '\0';
+    // empty file cannot be mapped
+    MappedFile file = { .data = "", .length = info.st_size };
+    if (file.length > 0) {
+        void* data = mmap(NULL, file.length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "io::file_map: failed to map file: %s\n", file_path);
+            exit(1);
+        }
+        file.data = data;
+    }
+    close(descriptor);
+
+    return file;
+}
 
-    fclose(file);
+void file_unmap(MappedFile* file) {
+    if (file->length > 0) {
+        munmap((void*)file->data, file->length);
+    }
+    file->data = NULL;
+    file->length = 0;
+}
 
-    return content;
+// absolute path with symlinks and '.' or '..' resolved, same file always gives same path
+char* file_canonical_path(const char* file_path) {
+    char* path = realpath(file_path, NULL);
+    if (path == NULL) {
+        fprintf(stderr, "io::file_canonical_path: failed to open file: %s\n", file_path);
+        exit(1);
+    }
+    return path;
 }
@@ -1,27 +1,38 @@
 #include <assert.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include "lexer.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_WIDTH 32
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMD_WIDTH 16
+#endif
+
 typedef struct Lexer {
     const char* start;
     const char* current;
+    const char* end;  // one past last character, source doesn't have to be NUL-terminated
     int line;
 } Lexer;
 
 static Lexer lexer = { 0 };
 
 inline static bool is_at_end() {
-    return *lexer.current == '\0';
+    return lexer.current >= lexer.end;
 }
 
+// characters past end read as '\0', which never continues a token
 inline static char peek() {
-    return *lexer.current;
+    return is_at_end() ? '\0' : *lexer.current;
 }
 
 inline static char peek_next() {
-    return *(lexer.current + 1);
+    return lexer.current + 1 >= lexer.end ? '\0' : lexer.current[1];
 }
 
 inline static char advance() {
@@ -35,6 +46,118 @@ static bool advance_if(char expected) {
     return true;
 }
 
+typedef enum {
+    CLASS_WHITESPACE,  // ' ', '\t', '\r' and '\n'
+    CLASS_DIGIT,
+    CLASS_IDENTIFIER,  // letters, digits and '_'
+} CharClass;
+
+inline static bool in_class(char c, CharClass class) {
+    switch (class) {
+        case CLASS_WHITESPACE: return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        case CLASS_DIGIT:      return c >= '0' && c <= '9';
+        case CLASS_IDENTIFIER: return isalnum((unsigned char)c) || c == '_';
+    }
+    return false;
+}
+
+#if defined(__AVX2__)
+
+typedef __m256i Block;
+
+inline static Block block_load(const char* p)   { return _mm256_loadu_si256((const __m256i*)p); }
+inline static Block block_set(char c)           { return _mm256_set1_epi8(c); }
+inline static Block block_eq(Block a, Block b)  { return _mm256_cmpeq_epi8(a, b); }
+inline static Block block_or(Block a, Block b)  { return _mm256_or_si256(a, b); }
+inline static Block block_and(Block a, Block b) { return _mm256_and_si256(a, b); }
+inline static Block block_min(Block a, Block b) { return _mm256_min_epu8(a, b); }
+inline static Block block_max(Block a, Block b) { return _mm256_max_epu8(a, b); }
+inline static uint32_t block_mask(Block a)      { return (uint32_t)_mm256_movemask_epi8(a); }
+
+#elif defined(__SSE2__)
+
+typedef __m128i Block;
+
+inline static Block block_load(const char* p)   { return _mm_loadu_si128((const __m128i*)p); }
+inline static Block block_set(char c)           { return _mm_set1_epi8(c); }
+inline static Block block_eq(Block a, Block b)  { return _mm_cmpeq_epi8(a, b); }
+inline static Block block_or(Block a, Block b)  { return _mm_or_si128(a, b); }
+inline static Block block_and(Block a, Block b) { return _mm_and_si128(a, b); }
+inline static Block block_min(Block a, Block b) { return _mm_min_epu8(a, b); }
+inline static Block block_max(Block a, Block b) { return _mm_max_epu8(a, b); }
+inline static uint32_t block_mask(Block a)      { return (uint32_t)_mm_movemask_epi8(a); }
+
+#endif
+
+#ifdef SIMD_WIDTH
+
+#define BLOCK_ALL ((uint32_t)(((uint64_t)1 << SIMD_WIDTH) - 1))
+
+// unsigned lo <= x <= hi for every byte
+inline static Block block_in_range(Block x, char lo, char hi) {
+    return block_and(block_eq(block_max(x, block_set(lo)), x), block_eq(block_min(x, block_set(hi)), x));
+}
+
+// bit i is set when p[i] belongs to class
+inline static uint32_t block_class_mask(const char* p, CharClass class) {
+    Block x = block_load(p);
+    switch (class) {
+        case CLASS_WHITESPACE:
+            return block_mask(block_or(block_or(block_eq(x, block_set(' ')), block_eq(x, block_set('\t'))),
+                                       block_or(block_eq(x, block_set('\r')), block_eq(x, block_set('\n')))));
+        case CLASS_DIGIT:
+            return block_mask(block_in_range(x, '0', '9'));
+        case CLASS_IDENTIFIER: {
+            // setting bit 5 maps upper case letters to lower case and leaves digits and '_' intact
+            Block lower = block_or(x, block_set(0x20));
+            return block_mask(block_or(block_or(block_in_range(lower, 'a', 'z'), block_in_range(x, '0', '9')),
+                                       block_eq(x, block_set('_'))));
+        }
+    }
+    return 0;
+}
+
+#endif
+
+// first character at or after p which is not in class, newlines skipped on the way are added to line
+static const char* scan_class(const char* p, const char* end, CharClass class, int* line) {
+#ifdef SIMD_WIDTH
+    while (end - p >= SIMD_WIDTH) {
+        uint32_t outside = ~block_class_mask(p, class) & BLOCK_ALL;
+        uint32_t newlines = class == CLASS_WHITESPACE ? block_mask(block_eq(block_load(p), block_set('\n'))) : 0;
+        if (outside != 0) {
+            int length = __builtin_ctz(outside);
+            *line += __builtin_popcount(newlines & (((uint32_t)1 << length) - 1));
+            return p + length;
+        }
+        *line += __builtin_popcount(newlines);
+        p += SIMD_WIDTH;
+    }
+#endif
+    while (p < end && in_class(*p, class)) {
+        if (*p == '\n') ++*line;
+        ++p;
+    }
+    return p;
+}
+
+static int count_newlines(const char* p, const char* end) {
+    int count = 0;
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        ++count;
+        ++p;
+    }
+    return count;
+}
+
+// first occurrence of c at or after p or end, newlines skipped on the way are added to line
+static const char* scan_until(const char* p, const char* end, char c, int* line) {
+    const char* found = memchr(p, c, end - p);
+    if (found == NULL) found = end;
+    if (c != '\n') *line += count_newlines(p, found);
+    return found;
+}
+
 static Token make_token(TokenType type) {
     return (Token){
         .type = type,
@@ -60,30 +183,25 @@ static void skip_whitespace() {
             case ' ':
             case '\t':
             case '\r':
-                advance();
-                break;
             case '\n':
-                ++lexer.line;
-                advance();
+                lexer.current = scan_class(lexer.current, lexer.end, CLASS_WHITESPACE, &lexer.line);
                 break;
             case '/':
                 // simple comment - //
                 if (peek_next() == '/') {
-                    while (peek() != '\n' && !is_at_end()) advance();
+                    lexer.current = scan_until(lexer.current, lexer.end, '\n', &lexer.line);
                 }
                 // multi-line comment - /* */
                 else if (peek_next() == '*') {
                     advance();  // consume /
                     advance();  // consume *
                     for (;;) {
-                        char c = advance();
-                        if (c == '\0') {
+                        lexer.current = scan_until(lexer.current, lexer.end, '*', &lexer.line);
+                        if (is_at_end()) {
                             break; // TODO: return error token - unterminated /*
                         }
-                        else if (c == '\n') {
-                            ++lexer.line;
-                        }
-                        else if (c == '*' && peek() == '/') {
+                        advance();  // consume *
+                        if (peek() == '/') {
                             advance(); // consume /
                             break;
                         }
@@ -100,10 +218,10 @@ static void skip_whitespace() {
 }
 
 static Token read_number() {
-    while (isdigit(peek())) advance();
+    lexer.current = scan_class(lexer.current, lexer.end, CLASS_DIGIT, &lexer.line);
 
     if (advance_if('.')) {
-        while (isdigit(peek())) advance();
+        lexer.current = scan_class(lexer.current, lexer.end, CLASS_DIGIT, &lexer.line);
 
         return make_token(TOKEN_FLOAT);
     }
@@ -111,12 +229,7 @@ static Token read_number() {
 }
 
 static Token read_string() {
-    while (peek() != '"' && !is_at_end()) {
-        if (peek() == '\n') {
-            ++lexer.line;
-        }
-        advance();
-    }
+    lexer.current = scan_until(lexer.current, lexer.end, '"', &lexer.line);
 
     if (is_at_end()) return make_error_token("unterminated string");
 
@@ -160,6 +273,7 @@ static TokenType identifier_type() {
                 switch (lexer.start[1]) {
                     case 'f': return (lexer.current - lexer.start == 2) ? TOKEN_IF : TOKEN_IDENTIFIER;
                     case 'm': return check_keyword(2, 4, "port", TOKEN_IMPORT);
+                    case 'n': return (lexer.current - lexer.start == 2) ? TOKEN_IN : TOKEN_IDENTIFIER;
                     default: break;
                 }
             }
@@ -176,16 +290,15 @@ static TokenType identifier_type() {
 }
 
 static Token read_identifier() {
-    while (isalnum(peek()) || peek() == '_') {
-        advance();
-    }
+    lexer.current = scan_class(lexer.current, lexer.end, CLASS_IDENTIFIER, &lexer.line);
 
     return make_token(identifier_type());
 }
 
-void lexer_init(const char* source) {
+void lexer_init(const char* source, size_t length) {
     lexer.start = source;
     lexer.current = source;
+    lexer.end = source + length;
     lexer.line = 1;
 }
 
@@ -301,6 +414,7 @@ const char* token_as_cstr(TokenType type) {
         "func",
         "if",
         "import",
+        "in",
         "null",
         "or",
         "return",
@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <string.h>
+#include "error.h"
+#include "map.h"
+#include "memory.h"
+
+static int capacity_for(int count) {
+    int capacity = MAP_INITIAL_CAPACITY;
+    while (count > capacity * MAP_LOAD_FACTOR) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+static MapEntry* entries_new(int capacity) {
+    MapEntry* entries = malloc(sizeof(MapEntry) * capacity);
+    for (int i = 0; i < capacity; ++i) {
+        entries[i].key = NULL_VALUE();
+        entries[i].value = NULL_VALUE();
+    }
+    return entries;
+}
+
+// finalizer of MurmurHash3, so consecutive integers don't fill consecutive entries
+static Hash hash_bits(uint64_t bits) {
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdull;
+    bits ^= bits >> 33;
+    return (Hash)bits;
+}
+
+static Hash hash_key(Value key) {
+    switch (VALUE_TYPE(key)) {
+        case VALUE_INT: return hash_bits((uint64_t)AS_INT(key));
+        case VALUE_FLOAT: {
+            double floating = AS_FLOAT(key) == 0.0 ? 0.0 : AS_FLOAT(key);  // -0.0 is the same key as 0.0
+            uint64_t bits;
+            memcpy(&bits, &floating, sizeof(bits));
+            return hash_bits(bits);
+        }
+        case VALUE_BOOL: return AS_BOOL(key);
+        default:         return AS_STRING(key)->hash;
+    }
+}
+
+static bool keys_equal(Value a, Value b) {
+    if (VALUE_TYPE(a) != VALUE_TYPE(b)) return false;
+    switch (VALUE_TYPE(a)) {
+        case VALUE_INT:   return AS_INT(a) == AS_INT(b);
+        case VALUE_FLOAT: return AS_FLOAT(a) == AS_FLOAT(b);
+        case VALUE_BOOL:  return AS_BOOL(a) == AS_BOOL(b);
+        default:          return AS_STRING(a) == AS_STRING(b);  // interned
+    }
+}
+
+// entry holding key, or entry where key should be inserted, preferring first tombstone on the way
+static MapEntry* find_entry(MapEntry* entries, int capacity, Value key) {
+    int index = hash_key(key) & (capacity - 1);
+    MapEntry* tombstone = NULL;
+    for (;;) {
+        MapEntry* entry = &entries[index];
+        if (IS_NULL(entry->key)) {
+            if (IS_NULL(entry->value)) {
+                return tombstone != NULL ? tombstone : entry;
+            }
+            if (tombstone == NULL) tombstone = entry;
+        }
+        else if (keys_equal(entry->key, key)) {
+            return entry;
+        }
+        index = (index + 1) & (capacity - 1);
+    }
+}
+
+// tombstones are dropped, so table may be rebuilt at the same capacity
+static void map_resize(Map* map, int new_capacity) {
+    MapEntry* new_entries = entries_new(new_capacity);
+    for (int i = 0; i < map->capacity; ++i) {
+        MapEntry* entry = &map->entries[i];
+        if (!IS_NULL(entry->key)) {
+            *find_entry(new_entries, new_capacity, entry->key) = *entry;
+        }
+    }
+    free(map->entries);
+    gc_track((long)sizeof(MapEntry) * (new_capacity - map->capacity));
+    map->entries = new_entries;
+    map->capacity = new_capacity;
+    map->used = map->count;
+}
+
+Map* map_new(int capacity) {
+    Map* map = (Map*)gc_allocate(sizeof(Map), OBJ_MAP);
+    map->capacity = capacity_for(capacity);
+    map->entries = entries_new(map->capacity);
+    map->count = 0;
+    map->used = 0;
+    gc_track(sizeof(MapEntry) * map->capacity);
+    return map;
+}
+
+Value map_key(Value key) {
+    switch (VALUE_TYPE(key)) {
+        case VALUE_INT:
+        case VALUE_FLOAT:
+        case VALUE_BOOL:   return key;
+        case VALUE_STRING: return STRING_VALUE(string_intern(AS_STRING(key)));
+        default: runtime_error("value of type '%s' cannot be a map key", value_type_as_cstr(VALUE_TYPE(key)));
+    }
+    return NULL_VALUE();
+}
+
+Value* map_get_ref(Map* map, Value key) {
+    MapEntry* entry = find_entry(map->entries, map->capacity, key);
+    return IS_NULL(entry->key) ? NULL : &entry->value;
+}
+
+bool map_set(Map* map, Value key, Value value) {
+    if (map->used + 1 > map->capacity * MAP_LOAD_FACTOR) {
+        // mostly tombstones are only cleared, otherwise table grows
+        bool crowded = map->count + 1 > map->capacity * MAP_LOAD_FACTOR / 2;
+        map_resize(map, crowded ? map->capacity * 2 : map->capacity);
+    }
+
+    MapEntry* entry = find_entry(map->entries, map->capacity, key);
+    bool present = !IS_NULL(entry->key);
+    if (!present) {
+        if (IS_NULL(entry->value)) ++map->used;  // tombstones are already counted
+        ++map->count;
+        entry->key = key;
+    }
+    entry->value = value;
+    return present;
+}
+
+bool map_remove(Map* map, Value key) {
+    MapEntry* entry = find_entry(map->entries, map->capacity, key);
+    if (IS_NULL(entry->key)) return false;
+
+    entry->key = NULL_VALUE();
+    entry->value = BOOL_VALUE(true);
+    --map->count;
+    return true;
+}
+
+int map_next(Map* map, int index) {
+    for (; index < map->capacity; ++index) {
+        if (!IS_NULL(map->entries[index].key)) return index;
+    }
+    return -1;
+}
+
+bool maps_equal(Map* a, Map* b) {
+    if (a->count != b->count) return false;
+    for (int i = map_next(a, 0); i >= 0; i = map_next(a, i + 1)) {
+        Value* value = map_get_ref(b, a->entries[i].key);
+        if (value == NULL || !values_equal(a->entries[i].value, *value)) return false;
+    }
+    return true;
+}
@@ -1,6 +1,24 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include "chunk.h"
+#include "environment.h"
+#include "interpreter.h"
 #include "memory.h"
+#include "profiler.h"
+#include "strings.h"
+#include "vm.h"
+
+static Obj* objects = NULL;
+static size_t bytes_allocated = 0;
+static size_t next_gc = GC_INITIAL_THRESHOLD;
+static double growth = GC_DEFAULT_GROWTH;
+static int pin_depth = 0;
+static GCStats stats = {0};
+
+// marked objects whose references are not traced yet
+static Obj** gray_stack = NULL;
+static int gray_count = 0;
+static int gray_capacity = 0;
 
 void* reallocate(void* pointer, int new_size) {
     if (new_size == 0) {
@@ -15,3 +33,219 @@ void* reallocate(void* pointer, int new_size) {
     }
     return result;
 }
+
+Obj* gc_allocate(size_t size, ObjType type) {
+#ifdef DEBUG_STRESS_GC
+    if (pin_depth == 0) gc_collect();
+#else
+    if (pin_depth == 0 && bytes_allocated > next_gc) gc_collect();
+#endif
+
+    Obj* object = calloc(1, size);
+    if (object == NULL) {
+        fprintf(stderr, "memory::gc_allocate: cannot allocate enough memory\n");
+        exit(1);
+    }
+    object->type = type;
+    object->pinned = pin_depth > 0;
+    object->next = objects;
+    objects = object;
+    bytes_allocated += size;
+    stats.allocations++;
+    stats.allocated_bytes += size;
+    return object;
+}
+
+void gc_track(long bytes) {
+    bytes_allocated += bytes;
+    if (bytes > 0) stats.allocated_bytes += bytes;
+}
+
+void gc_set_growth(double factor) {
+    growth = factor;
+}
+
+void gc_pin_begin() {
+    ++pin_depth;
+}
+
+void gc_pin_end() {
+    --pin_depth;
+}
+
+bool gc_pinning() {
+    return pin_depth > 0;
+}
+
+void gc_mark_object(Obj* object) {
+    if (object == NULL || object->marked) return;
+    object->marked = true;
+
+    if (gray_capacity < gray_count + 1) {
+        gray_capacity = GROW_CAPACITY(gray_capacity);
+        gray_stack = GROW_ARRAY(Obj*, gray_stack, gray_capacity);
+    }
+    gray_stack[gray_count++] = object;
+}
+
+void gc_mark_value(Value value) {
+    if (IS_STRING(value))        gc_mark_object((Obj*)AS_STRING(value));
+    else if (IS_LIST(value))     gc_mark_object((Obj*)AS_LIST(value));
+    else if (IS_MAP(value))      gc_mark_object((Obj*)AS_MAP(value));
+    else if (IS_NATIVE(value))   gc_mark_object((Obj*)AS_NATIVE(value));
+    else if (IS_FUNCTION(value)) gc_mark_object((Obj*)AS_FUNCTION(value));
+    else if (IS_MODULE(value))   gc_mark_object((Obj*)AS_MODULE(value));
+}
+
+void gc_mark_hashmap(HashMap* map) {
+    for (int i = 0; i < map->capacity; ++i) {
+        HashEntry* entry = &map->entries[i];
+        if (entry->key != NULL) {
+            gc_mark_object((Obj*)entry->key);
+            gc_mark_value(entry->value);
+        }
+    }
+}
+
+static void blacken(Obj* object) {
+    switch (object->type) {
+        case OBJ_STRING: {
+            String* string = (String*)object;
+            gc_mark_object((Obj*)string->left);
+            gc_mark_object((Obj*)string->right);
+        } break;
+        case OBJ_LIST: {
+            List* list = (List*)object;
+            if (list->kind != LIST_VALUES) break;  // packed numbers reference nothing
+            for (int i = 0; i < list->length; ++i) {
+                gc_mark_value(list->values[i]);
+            }
+        } break;
+        case OBJ_MAP: {
+            Map* map = (Map*)object;
+            for (int i = 0; i < map->capacity; ++i) {
+                gc_mark_value(map->entries[i].key);  // null for free entries
+                gc_mark_value(map->entries[i].value);
+            }
+        } break;
+        case OBJ_NATIVE: {
+            gc_mark_object((Obj*)((Native*)object)->name);
+        } break;
+        case OBJ_FUNCTION: {
+            // params are owned by AST
+            Function* function = (Function*)object;
+            gc_mark_object((Obj*)function->name);
+            gc_mark_object((Obj*)function->globals);
+            if (function->chunk != NULL) {
+                for (int i = 0; i < function->chunk->constant_count; ++i) {
+                    gc_mark_value(function->chunk->constants[i]);
+                }
+            }
+        } break;
+        case OBJ_MODULE: {
+            Module* module = (Module*)object;
+            gc_mark_object((Obj*)module->name);
+            gc_mark_object((Obj*)module->env);
+        } break;
+        case OBJ_ENVIRONMENT: {
+            Environment* env = (Environment*)object;
+            gc_mark_object((Obj*)env->enclosing);
+            gc_mark_hashmap(&env->map);
+        } break;
+    }
+}
+
+static void free_object(Obj* object) {
+    switch (object->type) {
+        case OBJ_STRING: {
+            String* string = (String*)object;
+            bytes_allocated -= sizeof(String);
+            if (string->data != NULL) {
+                bytes_allocated -= string->length + 1;
+            }
+            if (string->data != string->chars) {
+                free(string->data);  // flattened rope
+            }
+        } break;
+        case OBJ_LIST: {
+            List* list = (List*)object;
+            bytes_allocated -= sizeof(List) + list_element_size(list->kind) * list->capacity;
+            free(list->values);
+        } break;
+        case OBJ_MAP: {
+            Map* map = (Map*)object;
+            bytes_allocated -= sizeof(Map) + sizeof(MapEntry) * map->capacity;
+            free(map->entries);
+        } break;
+        case OBJ_NATIVE: {
+            bytes_allocated -= sizeof(Native);
+        } break;
+        case OBJ_FUNCTION: {
+            Function* function = (Function*)object;
+            bytes_allocated -= sizeof(Function);
+            if (function->chunk != NULL) {
+                chunk_free(function->chunk);
+            }
+        } break;
+        case OBJ_MODULE: {
+            bytes_allocated -= sizeof(Module);
+        } break;
+        case OBJ_ENVIRONMENT: {
+            Environment* env = (Environment*)object;
+            bytes_allocated -= sizeof(Environment);
+            hashmap_free(&env->map);
+        } break;
+    }
+    free(object);
+}
+
+static void sweep() {
+    Obj** link = &objects;
+    while (*link != NULL) {
+        Obj* object = *link;
+        if (object->marked || object->pinned) {
+            object->marked = false;
+            link = &object->next;
+        }
+        else {
+            *link = object->next;
+            free_object(object);
+        }
+    }
+}
+
+void gc_collect() {
+    stats.collections++;
+    interpreter_mark_roots();
+    vm_mark_roots();
+    profiler_mark_roots();
+
+    while (gray_count > 0) {
+        blacken(gray_stack[--gray_count]);
+    }
+
+    // intern table doesn't keep strings alive
+    interned_strings_remove_unmarked();
+    sweep();
+
+    next_gc = bytes_allocated * growth;
+    if (next_gc < GC_INITIAL_THRESHOLD) {
+        next_gc = GC_INITIAL_THRESHOLD;
+    }
+}
+
+GCStats gc_stats() {
+    return stats;
+}
+
+void gc_free_all() {
+    while (objects != NULL) {
+        Obj* next = objects->next;
+        free_object(objects);
+        objects = next;
+    }
+    free(gray_stack);
+    gray_stack = NULL;
+    gray_count = 0;
+    gray_capacity = 0;
+}
@@ -0,0 +1,415 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "environment.h"
+#include "error.h"
+#include "map.h"
+#include "memory.h"
+#include "natives.h"
+#include "operators.h"
+#include "value.h"
+#include "vector.h"
+
+static Value clock_native(int argc, Value* argv) {
+    (void)argc;
+    (void)argv;
+    return FLOAT_VALUE((double)clock() / CLOCKS_PER_SEC);
+}
+
+static Value print_native(int argc, Value* argv) {
+    for (int i = 0; i < argc; ++i) {
+        print_value(argv[i]);
+    }
+    fputc('\n', stdout);
+    return NULL_VALUE();
+}
+
+static Value input_native(int argc, Value* argv) {
+    if (argc == 1) print_value(argv[0]);
+    char buffer[1024];
+    if (fgets(buffer, sizeof(buffer), stdin) != NULL) {
+        buffer[strcspn(buffer, "\n")] = '\0';
+        return STRING_VALUE(string_from(buffer));
+    }
+    runtime_error("failed to read from input");
+    return NULL_VALUE();
+}
+
+static Value typeof_native(int argc, Value* argv) {
+    (void)argc;
+    return STRING_VALUE(string_from(value_type_as_cstr(VALUE_TYPE(argv[0]))));
+}
+
+static Value int_native(int argc, Value* argv) {
+    (void)argc;
+    Value arg = argv[0];
+    switch (VALUE_TYPE(arg)) {
+        case VALUE_NULL:   return INT_VALUE(0);
+        case VALUE_INT:    return arg;
+        case VALUE_FLOAT: {
+            // bounds are powers of two, so they convert to double exactly
+            double value = AS_FLOAT(arg);
+            if (!(value >= (double)INT_VALUE_MIN && value < -(double)INT_VALUE_MIN)) runtime_error("integer overflow");
+            return INT_VALUE((int64_t)value);
+        }
+        case VALUE_BOOL:   return INT_VALUE(AS_BOOL(arg) ? 1 : 0);
+        case VALUE_STRING: {
+            errno = 0;
+            int64_t value = strtoll(string_data(AS_STRING(arg)), NULL, 10);
+            if (errno == ERANGE || !int_fits(value)) runtime_error("integer overflow");
+            return INT_VALUE(value);
+        }
+        default: runtime_error("cannot convert from %s to int", value_type_as_cstr(VALUE_TYPE(arg)));
+    }
+    return NULL_VALUE();
+}
+
+static Value float_native(int argc, Value* argv) {
+    (void)argc;
+    Value arg = argv[0];
+    switch (VALUE_TYPE(arg)) {
+        case VALUE_NULL:   return FLOAT_VALUE(0.0);
+        case VALUE_INT:    return FLOAT_VALUE((double)AS_INT(arg));
+        case VALUE_FLOAT:  return arg;
+        case VALUE_BOOL:   return FLOAT_VALUE(AS_BOOL(arg) ? 1.0 : 0.0);
+        case VALUE_STRING: return FLOAT_VALUE(strtod(string_data(AS_STRING(arg)), NULL));
+        default: runtime_error("cannot convert from %s to float", value_type_as_cstr(VALUE_TYPE(arg)));
+    }
+    return NULL_VALUE();
+}
+
+static Value bool_native(int argc, Value* argv) {
+    (void)argc;
+    Value arg = argv[0];
+    switch (VALUE_TYPE(arg)) {
+        case VALUE_NULL:     return BOOL_VALUE(false);
+        case VALUE_INT:      return BOOL_VALUE(AS_INT(arg) != 0);
+        case VALUE_FLOAT:    return FLOAT_VALUE(AS_FLOAT(arg) != 0.0);
+        case VALUE_BOOL:     return arg;
+        case VALUE_STRING:   return BOOL_VALUE(AS_STRING(arg)->length != 0);
+        case VALUE_NATIVE:   return BOOL_VALUE(true);
+        case VALUE_FUNCTION: return BOOL_VALUE(true);
+        default: runtime_error("cannot convert from %s to bool", value_type_as_cstr(VALUE_TYPE(arg)));
+    }
+    return NULL_VALUE();
+}
+
+static Value string_native(int argc, Value* argv) {
+    (void)argc;
+    Value arg = argv[0];
+    switch (VALUE_TYPE(arg)) {
+        case VALUE_NULL:   return STRING_VALUE(string_from("null"));
+        case VALUE_INT: {
+            char buffer[64];
+            snprintf(buffer, sizeof(buffer), "%ld", AS_INT(arg));
+            return STRING_VALUE(string_from(buffer));
+        }
+        case VALUE_FLOAT: {
+            char buffer[64];
+            snprintf(buffer, sizeof(buffer), "%g", AS_FLOAT(arg));
+            return STRING_VALUE(string_from(buffer));
+        }
+        case VALUE_BOOL:   return STRING_VALUE(string_from(AS_BOOL(arg) ? "true" : "false"));
+        case VALUE_STRING: return arg;
+        case VALUE_NATIVE: return STRING_VALUE(AS_NATIVE(arg)->name);
+        case VALUE_FUNCTION: return STRING_VALUE(AS_FUNCTION(arg)->name);
+        default: runtime_error("cannot convert from %s to string", value_type_as_cstr(VALUE_TYPE(arg)));
+    }
+    return NULL_VALUE();
+}
+
+static List* list_argument(Value value) {
+    if (!IS_LIST(value)) runtime_error("expected list but got %s", value_type_as_cstr(VALUE_TYPE(value)));
+    return AS_LIST(value);
+}
+
+static Value append_native(int argc, Value* argv) {
+    (void)argc;
+    list_append(list_argument(argv[0]), argv[1]);
+    return NULL_VALUE();
+}
+
+static Value length_native(int argc, Value* argv) {
+    (void)argc;
+    Value arg = argv[0];
+    switch (VALUE_TYPE(arg)) {
+        case VALUE_LIST:   return INT_VALUE(AS_LIST(arg)->length);
+        case VALUE_MAP:    return INT_VALUE(AS_MAP(arg)->count);
+        case VALUE_STRING: return INT_VALUE(AS_STRING(arg)->length);
+        default: runtime_error("object of type '%s' has no length", value_type_as_cstr(VALUE_TYPE(arg)));
+    }
+    return NULL_VALUE();
+}
+
+static Map* map_argument(Value value) {
+    if (!IS_MAP(value)) runtime_error("expected map but got %s", value_type_as_cstr(VALUE_TYPE(value)));
+    return AS_MAP(value);
+}
+
+// list of keys or of values of map, in the order in which for-in visits them
+static Value map_entries(Value* argv, bool keys) {
+    Map* map = map_argument(argv[0]);
+    List* list = list_new(map->count);
+    for (int i = map_next(map, 0); i >= 0; i = map_next(map, i + 1)) {
+        list_append(list, keys ? map->entries[i].key : map->entries[i].value);
+    }
+    return LIST_VALUE(list);
+}
+
+static Value keys_native(int argc, Value* argv) {
+    (void)argc;
+    return map_entries(argv, true);
+}
+
+static Value values_native(int argc, Value* argv) {
+    (void)argc;
+    return map_entries(argv, false);
+}
+
+static Value has_native(int argc, Value* argv) {
+    (void)argc;
+    Map* map = map_argument(argv[0]);
+    return BOOL_VALUE(map_get_ref(map, map_key(argv[1])) != NULL);
+}
+
+static Value remove_native(int argc, Value* argv) {
+    (void)argc;
+    Map* map = map_argument(argv[0]);
+    return BOOL_VALUE(map_remove(map, map_key(argv[1])));
+}
+
+int64_t natives_range_arguments(int argc, Value* argv, int64_t* start, int64_t* step) {
+    for (int i = 0; i < argc; ++i) {
+        if (!IS_INT(argv[i])) runtime_error("range arguments must be integers");
+    }
+    int64_t end = AS_INT(argv[argc > 1 ? 1 : 0]);
+    *start = argc > 1 ? AS_INT(argv[0]) : 0;
+    *step = argc > 2 ? AS_INT(argv[2]) : 1;
+    if (*step == 0) runtime_error("range step cannot be zero");
+
+    // computed unsigned, so distances between any two integers don't overflow
+    uint64_t distance = 0;
+    if (*step > 0 && *start < end) distance = (uint64_t)end - (uint64_t)*start;
+    if (*step < 0 && *start > end) distance = (uint64_t)*start - (uint64_t)end;
+    uint64_t stride = *step > 0 ? (uint64_t)*step : -(uint64_t)*step;
+    uint64_t count = distance / stride + (distance % stride != 0);
+    // VM counts remaining iterations down in an int value
+    if (count > (uint64_t)INT_VALUE_MAX) runtime_error("range is too long");
+    return (int64_t)count;
+}
+
+static Value range_native(int argc, Value* argv) {
+    int64_t start, step;
+    int64_t count = natives_range_arguments(argc, argv, &start, &step);
+    if (count > INT_MAX) runtime_error("range is too long to make a list");
+    List* list = list_new_packed(LIST_INTS, (int)count);
+    uint64_t value = (uint64_t)start;
+    for (int i = 0; i < count; ++i) {
+        list->ints[i] = (int64_t)value;
+        value += (uint64_t)step;
+    }
+    return LIST_VALUE(list);
+}
+
+bool natives_is_range(Value callee) {
+    return IS_NATIVE(callee) && AS_NATIVE(callee)->function == range_native;
+}
+
+// element of boxed list, numeric natives only accept ints and floats
+static Value number_at(List* list, int index) {
+    Value value = list_get(list, index);
+    if (!IS_INT(value) && !IS_FLOAT(value)) {
+        runtime_error("expected list of numbers but found %s", value_type_as_cstr(VALUE_TYPE(value)));
+    }
+    return value;
+}
+
+static Value sum_native(int argc, Value* argv) {
+    (void)argc;
+    List* list = list_argument(argv[0]);
+    switch (list->kind) {
+        case LIST_INTS: {
+            int64_t sum;
+            if (!vector_sum_ints(list->ints, list->length, &sum)) runtime_error("integer overflow");
+            return INT_VALUE(sum);
+        }
+        case LIST_FLOATS: return FLOAT_VALUE(vector_sum_floats(list->floats, list->length));
+        default: {
+            Value sum = INT_VALUE(0);
+            for (int i = 0; i < list->length; ++i) {
+                sum = operator_binary(TOKEN_PLUS, sum, number_at(list, i));
+            }
+            return sum;
+        }
+    }
+}
+
+static Value extreme(Value* argv, TokenType op) {
+    List* list = list_argument(argv[0]);
+    if (list->length == 0) runtime_error("expected non-empty list");
+    switch (list->kind) {
+        case LIST_INTS: {
+            return INT_VALUE(op == TOKEN_LESS ? vector_min_ints(list->ints, list->length)
+                                              : vector_max_ints(list->ints, list->length));
+        }
+        case LIST_FLOATS: {
+            return FLOAT_VALUE(op == TOKEN_LESS ? vector_min_floats(list->floats, list->length)
+                                                : vector_max_floats(list->floats, list->length));
+        }
+        default: {
+            Value result = number_at(list, 0);
+            for (int i = 1; i < list->length; ++i) {
+                Value value = number_at(list, i);
+                if (is_truthy(operator_binary(op, value, result))) result = value;
+            }
+            return result;
+        }
+    }
+}
+
+static Value min_native(int argc, Value* argv) {
+    (void)argc;
+    return extreme(argv, TOKEN_LESS);
+}
+
+static Value max_native(int argc, Value* argv) {
+    (void)argc;
+    return extreme(argv, TOKEN_GREATER);
+}
+
+static Value dot_native(int argc, Value* argv) {
+    (void)argc;
+    List* a = list_argument(argv[0]);
+    List* b = list_argument(argv[1]);
+    if (a->length != b->length) runtime_error("lists have different lengths: %d and %d", a->length, b->length);
+
+    if (a->kind == LIST_INTS && b->kind == LIST_INTS) {
+        int64_t sum;
+        if (!vector_dot_ints(a->ints, b->ints, a->length, &sum)) runtime_error("integer overflow");
+        return INT_VALUE(sum);
+    }
+    if (a->kind == LIST_FLOATS && b->kind == LIST_FLOATS) {
+        return FLOAT_VALUE(vector_dot_floats(a->floats, b->floats, a->length));
+    }
+    Value sum = INT_VALUE(0);
+    for (int i = 0; i < a->length; ++i) {
+        sum = operator_binary(TOKEN_PLUS, sum, operator_binary(TOKEN_ASTERISK, number_at(a, i), number_at(b, i)));
+    }
+    return sum;
+}
+
+// list op list of same length, or list op number
+static Value elementwise(Value* argv, TokenType op) {
+    List* a = list_argument(argv[0]);
+    List* b = IS_LIST(argv[1]) ? AS_LIST(argv[1]) : NULL;
+    if (b != NULL && a->length != b->length) {
+        runtime_error("lists have different lengths: %d and %d", a->length, b->length);
+    }
+    if (b == NULL && !IS_INT(argv[1]) && !IS_FLOAT(argv[1])) {
+        runtime_error("expected list or number but got %s", value_type_as_cstr(VALUE_TYPE(argv[1])));
+    }
+
+    int64_t int_scalar = IS_INT(argv[1]) ? AS_INT(argv[1]) : 0;
+    double float_scalar = IS_FLOAT(argv[1]) ? AS_FLOAT(argv[1]) : 0.0;
+    int b_step = b != NULL ? 1 : 0;
+
+    if (a->kind == LIST_INTS && (b != NULL ? b->kind == LIST_INTS : IS_INT(argv[1]))) {
+        const int64_t* right = b != NULL ? b->ints : &int_scalar;
+        List* result = list_new_packed(LIST_INTS, a->length);
+        int failed = vector_op_ints(op, result->ints, a->ints, right, b_step, a->length);
+        if (failed >= 0) runtime_error(right[failed * b_step] == 0 ? "division by zero" : "integer overflow");
+        return LIST_VALUE(result);
+    }
+    if (a->kind == LIST_FLOATS && (b != NULL ? b->kind == LIST_FLOATS : IS_FLOAT(argv[1]))) {
+        const double* right = b != NULL ? b->floats : &float_scalar;
+        if (op == TOKEN_SLASH) {
+            for (int i = 0; i < a->length; ++i) {
+                if (right[i * b_step] == 0.0) runtime_error("division by zero");
+            }
+        }
+        List* result = list_new_packed(LIST_FLOATS, a->length);
+        vector_op_floats(op, result->floats, a->floats, right, b_step, a->length);
+        return LIST_VALUE(result);
+    }
+
+    // arithmetic on numbers doesn't allocate, so result can't be collected while it is filled
+    List* result = list_new(a->length);
+    for (int i = 0; i < a->length; ++i) {
+        Value right = b != NULL ? number_at(b, i) : argv[1];
+        list_append(result, operator_binary(op, number_at(a, i), right));
+    }
+    return LIST_VALUE(result);
+}
+
+static Value vadd_native(int argc, Value* argv) {
+    (void)argc;
+    return elementwise(argv, TOKEN_PLUS);
+}
+
+static Value vsub_native(int argc, Value* argv) {
+    (void)argc;
+    return elementwise(argv, TOKEN_MINUS);
+}
+
+static Value vmul_native(int argc, Value* argv) {
+    (void)argc;
+    return elementwise(argv, TOKEN_ASTERISK);
+}
+
+static Value vdiv_native(int argc, Value* argv) {
+    (void)argc;
+    return elementwise(argv, TOKEN_SLASH);
+}
+
+void natives_arity_error(Native* native, int argc) {
+    if (native->max_arity == NATIVE_VARIADIC) {
+        runtime_error("expected at least %d arguments but got %d", native->min_arity, argc);
+    }
+    else if (native->min_arity != native->max_arity) {
+        runtime_error("expected %d to %d arguments but got %d", native->min_arity, native->max_arity, argc);
+    }
+    else {
+        runtime_error("expected %d argument%s but got %d", native->min_arity, native->min_arity == 1 ? "" : "s", argc);
+    }
+}
+
+static void define(Environment* env, const char* name, NativeFn function, int min_arity, int max_arity) {
+    String* string = string_from(name);
+    env_define(env, string, NATIVE_VALUE(native_new(string, function, min_arity, max_arity)));
+}
+
+// natives live as long as the program, so they are pinned
+void natives_define(Environment* env) {
+    gc_pin_begin();
+    define(env, "clock", clock_native, 0, 0);
+    define(env, "print", print_native, 0, NATIVE_VARIADIC);
+    define(env, "input", input_native, 0, 1);
+    define(env, "typeof", typeof_native, 1, 1);
+
+    define(env, "int", int_native, 1, 1);
+    define(env, "float", float_native, 1, 1);
+    define(env, "bool", bool_native, 1, 1);
+    define(env, "string", string_native, 1, 1);
+
+    define(env, "append", append_native, 2, 2);
+    define(env, "length", length_native, 1, 1);
+    define(env, "range", range_native, 1, 3);
+
+    define(env, "keys", keys_native, 1, 1);
+    define(env, "values", values_native, 1, 1);
+    define(env, "has", has_native, 2, 2);
+    define(env, "remove", remove_native, 2, 2);
+
+    define(env, "sum", sum_native, 1, 1);
+    define(env, "min", min_native, 1, 1);
+    define(env, "max", max_native, 1, 1);
+    define(env, "dot", dot_native, 2, 2);
+    define(env, "vadd", vadd_native, 2, 2);
+    define(env, "vsub", vsub_native, 2, 2);
+    define(env, "vmul", vmul_native, 2, 2);
+    define(env, "vdiv", vdiv_native, 2, 2);
+    gc_pin_end();
+}
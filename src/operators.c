@@ -0,0 +1,284 @@
+#include "error.h"
+#include "map.h"
+#include "operators.h"
+
+bool is_truthy(Value value) {
+    switch (VALUE_TYPE(value)) {
+        case VALUE_NULL:   return false;
+        case VALUE_INT: return AS_INT(value) != 0;
+        case VALUE_FLOAT: return AS_FLOAT(value) != 0.0;
+        case VALUE_BOOL:   return AS_BOOL(value);
+        case VALUE_STRING: return AS_STRING(value)->length != 0;
+        case VALUE_LIST:   return AS_LIST(value)->length != 0;
+        case VALUE_MAP:    return AS_MAP(value)->count != 0;
+        case VALUE_NATIVE: return true;
+        case VALUE_FUNCTION: return true;
+        case VALUE_MODULE: return true;
+    }
+    return false;
+}
+
+// division by zero is reported by callers, so operator_ints() fails only on overflow
+static Value ints_result(TokenType op, int64_t a, int64_t b) {
+    Value result;
+    if (!operator_ints(op, a, b, &result)) runtime_error("integer overflow");
+    return result;
+}
+
+static Value promote(Value value, ValueType target_type) {
+    ValueType value_type = VALUE_TYPE(value);
+    Value result = NULL_VALUE();
+    switch (target_type) {
+        case VALUE_INT: {
+            switch (value_type) {
+                case VALUE_INT:   return value;
+                case VALUE_FLOAT: result = INT_VALUE((int64_t)AS_FLOAT(value)); break;
+                case VALUE_BOOL:  result = INT_VALUE(AS_BOOL(value) ? 1 : 0); break;
+                default: {
+                    runtime_error(
+                        "cannot promote value type from %s to %s",
+                        value_type_as_cstr(value_type),
+                        value_type_as_cstr(target_type)
+                    );
+                } break;
+            }
+        } break;
+        case VALUE_FLOAT: {
+            switch (value_type) {
+                case VALUE_INT:   result = FLOAT_VALUE((double)AS_INT(value)); break;
+                case VALUE_FLOAT: return value;
+                case VALUE_BOOL:  result = FLOAT_VALUE(AS_BOOL(value) ? 1.0 : 0.0); break;
+                default: {
+                    runtime_error(
+                        "cannot promote value type from %s to %s",
+                        value_type_as_cstr(value_type),
+                        value_type_as_cstr(target_type)
+                    );
+                } break;
+            }
+        } break;
+        case VALUE_BOOL: {
+            switch (value_type) {
+                case VALUE_INT:   result = BOOL_VALUE(AS_INT(value) != 0); break;
+                case VALUE_FLOAT: result = BOOL_VALUE(AS_FLOAT(value) != 0.0); break;
+                case VALUE_BOOL:  return value;
+                default: {
+                    runtime_error(
+                        "cannot promote value type from %s to %s",
+                        value_type_as_cstr(value_type),
+                        value_type_as_cstr(target_type)
+                    );
+                } break;
+            }
+        } break;
+        default: {
+            runtime_error(
+                "cannot promote value type from %s to %s",
+                value_type_as_cstr(value_type),
+                value_type_as_cstr(target_type)
+            );
+        } break;
+    }
+    return result;
+}
+
+Value operator_unary(TokenType op, Value value) {
+    switch (op) {
+        case TOKEN_MINUS: {
+            if (VALUE_TYPE(value) == VALUE_INT) value = ints_result(TOKEN_MINUS, 0, AS_INT(value));
+            else if (VALUE_TYPE(value) == VALUE_FLOAT) value = FLOAT_VALUE(-AS_FLOAT(value));
+            else if (VALUE_TYPE(value) == VALUE_BOOL) value = INT_VALUE(-AS_BOOL(value));
+            else {
+                runtime_error(
+                    "cannot perform unary operation '%s' for '%s'",
+                    token_as_cstr(TOKEN_MINUS),
+                    value_type_as_cstr(VALUE_TYPE(value))
+                );
+            }
+            return value;
+        }
+        case TOKEN_NOT: {
+            return BOOL_VALUE(!is_truthy(value));
+        }
+        default: break;
+    }
+    return NULL_VALUE();
+}
+
+Value operator_binary(TokenType op, Value left, Value right) {
+    if (op == TOKEN_EQUAL_EQUAL) {
+        return BOOL_VALUE(values_equal(left, right));
+    }
+    if (op == TOKEN_NOT_EQUAL) {
+        return BOOL_VALUE(!values_equal(left, right));
+    }
+
+    ValueType left_type = VALUE_TYPE(left);
+    ValueType right_type = VALUE_TYPE(right);
+
+    // ugly hack for string concatenation
+    if (op == TOKEN_PLUS && (left_type == VALUE_STRING || right_type == VALUE_STRING)) {
+        if (left_type == VALUE_STRING && right_type == VALUE_STRING) {
+            return STRING_VALUE(string_concat(AS_STRING(left), AS_STRING(right)));
+        }
+        runtime_error("string concatenation is only possible for two strings");
+    }
+
+    if (left_type < VALUE_INT || left_type > VALUE_BOOL || right_type < VALUE_INT || right_type > VALUE_BOOL) {
+        runtime_error(
+            "cannot perform binary operation '%s' for '%s' and '%s'",
+            token_as_cstr(op),
+            value_type_as_cstr(left_type),
+            value_type_as_cstr(right_type)
+        );
+    }
+
+    ValueType result_type = VALUE_NULL;
+    if (left_type == VALUE_FLOAT || right_type == VALUE_FLOAT) result_type = VALUE_FLOAT;
+    else if (left_type == VALUE_INT || right_type == VALUE_INT) result_type = VALUE_INT;
+    else result_type = VALUE_BOOL;
+
+    left = promote(left, result_type);
+    right = promote(right, result_type);
+
+    switch (op) {
+        case TOKEN_PLUS: {
+            if (result_type == VALUE_INT) return ints_result(op, AS_INT(left), AS_INT(right));
+            if (result_type == VALUE_FLOAT) return FLOAT_VALUE(AS_FLOAT(left) + AS_FLOAT(right)); 
+            return INT_VALUE(AS_BOOL(left) + AS_BOOL(right));
+        }
+        case TOKEN_MINUS: {
+            if (result_type == VALUE_INT) return ints_result(op, AS_INT(left), AS_INT(right));
+            if (result_type == VALUE_FLOAT) return FLOAT_VALUE(AS_FLOAT(left) - AS_FLOAT(right)); 
+            return INT_VALUE(AS_BOOL(left) - AS_BOOL(right));
+        }
+        case TOKEN_ASTERISK: {
+            if (result_type == VALUE_INT) return ints_result(op, AS_INT(left), AS_INT(right));
+            if (result_type == VALUE_FLOAT) return FLOAT_VALUE(AS_FLOAT(left) * AS_FLOAT(right)); 
+            return INT_VALUE(AS_BOOL(left) * AS_BOOL(right));
+        }
+        case TOKEN_SLASH: {
+            if (result_type == VALUE_INT) {
+                if (AS_INT(right) == 0) runtime_error("division by zero");
+                return ints_result(op, AS_INT(left), AS_INT(right));
+            }
+            if (result_type == VALUE_FLOAT) {
+                if (AS_FLOAT(right) == 0.0) runtime_error("division by zero");
+                return FLOAT_VALUE(AS_FLOAT(left) / AS_FLOAT(right));
+            }
+            if (AS_BOOL(right) == false) runtime_error("division by zero");
+            return INT_VALUE(AS_BOOL(left) / AS_BOOL(right));
+        }
+        case TOKEN_PERCENT: {
+            if (result_type != VALUE_INT) runtime_error("modulo operation is only allowed for integers");
+            if (AS_INT(right) == 0) runtime_error("modulo by zero");
+            return ints_result(op, AS_INT(left), AS_INT(right));
+        }
+        case TOKEN_GREATER: {
+            if (result_type == VALUE_INT) return BOOL_VALUE(AS_INT(left) > AS_INT(right));
+            if (result_type == VALUE_FLOAT) return BOOL_VALUE(AS_FLOAT(left) > AS_FLOAT(right)); 
+            return BOOL_VALUE(AS_BOOL(left) > AS_BOOL(right));
+        }
+        case TOKEN_GREATER_EQUAL: {
+            if (result_type == VALUE_INT) return BOOL_VALUE(AS_INT(left) >= AS_INT(right));
+            if (result_type == VALUE_FLOAT) return BOOL_VALUE(AS_FLOAT(left) >= AS_FLOAT(right)); 
+            return BOOL_VALUE(AS_BOOL(left) >= AS_BOOL(right));
+        }
+        case TOKEN_LESS: {
+            if (result_type == VALUE_INT) return BOOL_VALUE(AS_INT(left) < AS_INT(right));
+            if (result_type == VALUE_FLOAT) return BOOL_VALUE(AS_FLOAT(left) < AS_FLOAT(right)); 
+            return BOOL_VALUE(AS_BOOL(left) < AS_BOOL(right));
+        }
+        case TOKEN_LESS_EQUAL: {
+            if (result_type == VALUE_INT) return BOOL_VALUE(AS_INT(left) <= AS_INT(right));
+            if (result_type == VALUE_FLOAT) return BOOL_VALUE(AS_FLOAT(left) <= AS_FLOAT(right)); 
+            return BOOL_VALUE(AS_BOOL(left) <= AS_BOOL(right));
+        }
+        default: break;
+    }
+    return NULL_VALUE();
+}
+
+Value operator_compound(TokenType op, Value target, Value value) {
+    ValueType target_type = VALUE_TYPE(target);
+    ValueType value_type = VALUE_TYPE(value);
+
+    if (op == TOKEN_PLUS_EQUAL && (target_type == VALUE_STRING || value_type == VALUE_STRING)) {
+        if (target_type == VALUE_STRING && value_type == VALUE_STRING) {
+            return STRING_VALUE(string_concat(AS_STRING(target), AS_STRING(value)));
+        }
+        runtime_error("string concatenation is only possible for two strings");
+    }
+
+    if (target_type < VALUE_INT || target_type > VALUE_BOOL || value_type < VALUE_INT || value_type > VALUE_BOOL) {
+        runtime_error(
+            "cannot perform assignment operation '%s' for '%s' and '%s'",
+            token_as_cstr(op),
+            value_type_as_cstr(target_type),
+            value_type_as_cstr(value_type)
+        );
+    }
+
+    ValueType result_type = VALUE_NULL;
+    if (target_type == VALUE_FLOAT || value_type == VALUE_FLOAT) result_type = VALUE_FLOAT;
+    else result_type = VALUE_INT;
+
+    target = promote(target, result_type);
+    value = promote(value, result_type);
+
+    switch (op) {
+        case TOKEN_PLUS_EQUAL: {
+            if (result_type == VALUE_INT) target = ints_result(op, AS_INT(target), AS_INT(value));
+            else target = FLOAT_VALUE(AS_FLOAT(target) + AS_FLOAT(value));
+        } break;
+        case TOKEN_MINUS_EQUAL: {
+            if (result_type == VALUE_INT) target = ints_result(op, AS_INT(target), AS_INT(value));
+            else target = FLOAT_VALUE(AS_FLOAT(target) - AS_FLOAT(value));
+        } break;
+        case TOKEN_ASTERISK_EQUAL: {
+            if (result_type == VALUE_INT) target = ints_result(op, AS_INT(target), AS_INT(value));
+            else target = FLOAT_VALUE(AS_FLOAT(target) * AS_FLOAT(value));
+        } break;
+        case TOKEN_SLASH_EQUAL: {
+            if (result_type == VALUE_INT) {
+                if (AS_INT(value) == 0) runtime_error("division by zero");
+                target = ints_result(op, AS_INT(target), AS_INT(value));
+            }
+            else {
+                if (AS_FLOAT(value) == 0.0) runtime_error("division by zero");
+                target = FLOAT_VALUE(AS_FLOAT(target) / AS_FLOAT(value));
+            }
+        } break;
+        case TOKEN_PERCENT_EQUAL: {
+            if (result_type != VALUE_INT) runtime_error("modulo operation is only allowed for integers");
+            if (AS_INT(value) == 0) runtime_error("modulo by zero");
+            target = ints_result(op, AS_INT(target), AS_INT(value));
+        } break;
+        default: break;
+    }
+    return target;
+}
+
+Value operator_subscript_get(Value object, Value index) {
+    if (IS_MAP(object)) {
+        Value* value = map_get_ref(AS_MAP(object), map_key(index));
+        if (value == NULL) runtime_error("key not found in map");
+        return *value;
+    }
+    if (!IS_LIST(object)) runtime_error("object is not subscriptable");
+    if (!IS_INT(index)) runtime_error("list index must be an integer");
+    if (AS_INT(index) < 0 || AS_INT(index) >= AS_LIST(object)->length) runtime_error("index out of range");
+    return list_get(AS_LIST(object), (int)AS_INT(index));
+}
+
+// assignment to missing key of map inserts it
+void operator_subscript_set(Value object, Value index, Value value) {
+    if (IS_MAP(object)) {
+        map_set(AS_MAP(object), map_key(index), value);
+        return;
+    }
+    if (!IS_LIST(object)) runtime_error("object is not subscriptable");
+    if (!IS_INT(index)) runtime_error("list index must be an integer");
+    if (AS_INT(index) < 0 || AS_INT(index) >= AS_LIST(object)->length) runtime_error("index out of range");
+    list_set(AS_LIST(object), (int)AS_INT(index), value);
+}
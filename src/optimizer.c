@@ -0,0 +1,219 @@
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+#include "operators.h"
+#include "optimizer.h"
+#include "strings.h"
+
+static Arena* arena = NULL;
+
+static ASTNode* make_literal(int line, Value value) {
+    ASTNodeLiteral* node = arena_alloc(arena, sizeof(ASTNodeLiteral));
+    node->base.type = AST_NODE_LITERAL;
+    node->base.line = line;
+    node->value = value;
+    return (ASTNode*)node;
+}
+
+// takes place of removed statement where one is required
+static ASTNode* make_empty_block(int line) {
+    ASTNodeBlock* node = arena_alloc(arena, sizeof(ASTNodeBlock));
+    node->base.type = AST_NODE_BLOCK;
+    node->base.line = line;
+    return (ASTNode*)node;
+}
+
+static bool is_literal(ASTNode* node) {
+    return node != NULL && node->type == AST_NODE_LITERAL;
+}
+
+static Value literal_value(ASTNode* node) {
+    return ((ASTNodeLiteral*)node)->value;
+}
+
+static bool is_number(Value value) {
+    return IS_INT(value) || IS_FLOAT(value) || IS_BOOL(value);
+}
+
+static int64_t as_int(Value value) {
+    return IS_INT(value) ? AS_INT(value) : AS_BOOL(value);
+}
+
+// mirrors checks of operator_binary(), so folding never removes a runtime error
+static bool binary_folds(TokenType op, Value left, Value right) {
+    if (op == TOKEN_EQUAL_EQUAL || op == TOKEN_NOT_EQUAL) return true;
+    if (op == TOKEN_PLUS && IS_STRING(left) && IS_STRING(right)) return true;
+    if (!is_number(left) || !is_number(right)) return false;
+    if (!IS_FLOAT(left) && !IS_FLOAT(right) && (IS_INT(left) || IS_INT(right))) {
+        // refuses overflow and division by zero
+        Value result;
+        return operator_ints(op, as_int(left), as_int(right), &result);
+    }
+    return op != TOKEN_PERCENT && (op != TOKEN_SLASH || is_truthy(right));  // zero of any number type
+}
+
+// literal strings are interned, unlike ropes made by string_concat()
+static Value concat_literals(String* a, String* b) {
+    int length = a->length + b->length;
+    char* buffer = malloc(length);
+    memcpy(buffer, string_data(a), a->length);
+    memcpy(buffer + a->length, string_data(b), b->length);
+    String* string = intern_string(buffer, length);
+    free(buffer);
+    return STRING_VALUE(string);
+}
+
+static ASTNode* fold(ASTNode* root);
+
+// body of loop or if keeps a statement, even when all of it is removed
+static ASTNode* fold_body(ASTNode* body) {
+    if (body == NULL) return NULL;
+    ASTNode* folded = fold(body);
+    return folded != NULL ? folded : make_empty_block(body->line);
+}
+
+// returns node that replaces given one, NULL if statement is removed
+static ASTNode* fold(ASTNode* root) {
+    if (root == NULL) return NULL;
+
+    switch (root->type) {
+        case AST_NODE_PROGRAM:
+        case AST_NODE_BLOCK: {
+            ASTNodeBlock* block = (ASTNodeBlock*)root;
+            int count = 0;
+            for (int i = 0; i < block->count; ++i) {
+                ASTNode* statement = fold(block->statements[i]);
+                if (statement != NULL) block->statements[count++] = statement;
+            }
+            block->count = count;
+        } break;
+        case AST_NODE_FUNC_DECL: {
+            ASTNodeFuncDecl* func_decl = (ASTNodeFuncDecl*)root;
+            func_decl->body = fold_body(func_decl->body);
+        } break;
+        case AST_NODE_VAR_DECL: {
+            ASTNodeVarDecl* var_decl = (ASTNodeVarDecl*)root;
+            var_decl->initializer = fold(var_decl->initializer);
+        } break;
+        case AST_NODE_EXPR_STMT: {
+            ASTNodeExprStmt* expr_stmt = (ASTNodeExprStmt*)root;
+            expr_stmt->expression = fold(expr_stmt->expression);
+            if (is_literal(expr_stmt->expression)) return NULL;  // has no effect
+        } break;
+        case AST_NODE_RETURN_STMT: {
+            ASTNodeExprStmt* return_stmt = (ASTNodeExprStmt*)root;
+            return_stmt->expression = fold(return_stmt->expression);
+        } break;
+        case AST_NODE_TERNARY:
+        case AST_NODE_IF_STMT: {
+            ASTNodeIfStmt* if_stmt = (ASTNodeIfStmt*)root;
+            if_stmt->condition = fold(if_stmt->condition);
+            if_stmt->then_branch = fold_body(if_stmt->then_branch);
+            if_stmt->else_branch = fold(if_stmt->else_branch);
+            if (is_literal(if_stmt->condition)) {
+                return is_truthy(literal_value(if_stmt->condition)) ? if_stmt->then_branch : if_stmt->else_branch;
+            }
+        } break;
+        case AST_NODE_WHILE_STMT: {
+            ASTNodeWhileStmt* while_stmt = (ASTNodeWhileStmt*)root;
+            while_stmt->condition = fold(while_stmt->condition);
+            if (is_literal(while_stmt->condition) && !is_truthy(literal_value(while_stmt->condition))) return NULL;
+            while_stmt->body = fold_body(while_stmt->body);
+        } break;
+        case AST_NODE_FOR_STMT: {
+            ASTNodeForStmt* for_stmt = (ASTNodeForStmt*)root;
+            for_stmt->initializer = fold(for_stmt->initializer);
+            for_stmt->condition = fold(for_stmt->condition);
+            for_stmt->increment = fold(for_stmt->increment);
+            for_stmt->body = fold_body(for_stmt->body);
+        } break;
+        case AST_NODE_FOR_IN_STMT: {
+            ASTNodeForInStmt* for_in = (ASTNodeForInStmt*)root;
+            for_in->iterable = fold(for_in->iterable);
+            for_in->body = fold_body(for_in->body);
+        } break;
+        case AST_NODE_ASSIGNMENT: {
+            // target is a variable, member or element, which are never replaced
+            ASTNodeAssignment* assignment = (ASTNodeAssignment*)root;
+            fold(assignment->target);
+            assignment->value = fold(assignment->value);
+        } break;
+        case AST_NODE_LOGICAL: {
+            ASTNodeBinary* logical = (ASTNodeBinary*)root;
+            logical->left = fold(logical->left);
+            logical->right = fold(logical->right);
+            if (is_literal(logical->left)) {
+                bool left_decides = is_truthy(literal_value(logical->left)) == (logical->op == TOKEN_OR);
+                return left_decides ? logical->left : logical->right;
+            }
+        } break;
+        case AST_NODE_BINARY: {
+            ASTNodeBinary* binary = (ASTNodeBinary*)root;
+            binary->left = fold(binary->left);
+            binary->right = fold(binary->right);
+            if (!is_literal(binary->left) || !is_literal(binary->right)) break;
+
+            Value left = literal_value(binary->left);
+            Value right = literal_value(binary->right);
+            if (!binary_folds(binary->op, left, right)) break;
+            if (IS_STRING(left) && IS_STRING(right) && binary->op == TOKEN_PLUS) {
+                return make_literal(root->line, concat_literals(AS_STRING(left), AS_STRING(right)));
+            }
+            return make_literal(root->line, operator_binary(binary->op, left, right));
+        }
+        case AST_NODE_UNARY: {
+            ASTNodeUnary* unary = (ASTNodeUnary*)root;
+            unary->right = fold(unary->right);
+            if (!is_literal(unary->right)) break;
+
+            Value right = literal_value(unary->right);
+            if (unary->op == TOKEN_MINUS && !is_number(right)) break;
+            if (unary->op == TOKEN_MINUS && IS_INT(right) && AS_INT(right) == INT_VALUE_MIN) break;  // overflows
+            return make_literal(root->line, operator_unary(unary->op, right));
+        }
+        case AST_NODE_CALL: {
+            ASTNodeCall* call = (ASTNodeCall*)root;
+            call->callee = fold(call->callee);
+            for (int i = 0; i < call->count; ++i) {
+                call->arguments[i] = fold(call->arguments[i]);
+            }
+        } break;
+        case AST_NODE_GET: {
+            ASTNodeGet* get = (ASTNodeGet*)root;
+            get->object = fold(get->object);
+        } break;
+        case AST_NODE_SUBSCRIPTION: {
+            ASTNodeSubscription* subscription = (ASTNodeSubscription*)root;
+            subscription->expression = fold(subscription->expression);
+            subscription->index = fold(subscription->index);
+        } break;
+        case AST_NODE_LIST: {
+            ASTNodeList* list = (ASTNodeList*)root;
+            for (int i = 0; i < list->count; ++i) {
+                list->expressions[i] = fold(list->expressions[i]);
+            }
+        } break;
+        case AST_NODE_MAP: {
+            ASTNodeMap* map = (ASTNodeMap*)root;
+            for (int i = 0; i < map->count; ++i) {
+                map->keys[i] = fold(map->keys[i]);
+                map->values[i] = fold(map->values[i]);
+            }
+        } break;
+        case AST_NODE_IMPORT:
+        case AST_NODE_BREAK:
+        case AST_NODE_CONTINUE:
+        case AST_NODE_LITERAL:
+        case AST_NODE_VAR: break;
+    }
+    return root;
+}
+
+void optimizer_fold_constants(ASTNode* root, Arena* node_arena) {
+    arena = node_arena;
+    // folded strings are referenced by AST, as those made by parser
+    gc_pin_begin();
+    fold(root);
+    gc_pin_end();
+    arena = NULL;
+}
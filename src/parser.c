@@ -1,18 +1,23 @@
+#include <errno.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "arena.h"
 #include "lexer.h"
 #include "memory.h"
 #include "parser.h"
 #include "value.h"
 
+#define NUMBER_MAX_LENGTH 511  // longer literals are rejected, they are copied to stack buffer
+
 typedef struct Parser {
     Token current;
     Token previous;
     bool had_error;
     bool panic_mode;
+    Arena* arena;  // all nodes of parsed tree are allocated here
 } Parser;
 
 static Parser parser;
@@ -88,29 +93,30 @@ static void synchronize() {
 }
 
 static ASTNode* make_node_program() {
-    ASTNodeBlock* node = calloc(1, sizeof(ASTNodeBlock));
+    ASTNodeBlock* node = arena_alloc(parser.arena, sizeof(ASTNodeBlock));
     node->base.type = AST_NODE_PROGRAM;
     return (ASTNode*)node;
 }
 
 static ASTNode* make_node_block(int line) {
-    ASTNodeBlock* node = calloc(1, sizeof(ASTNodeBlock));
+    ASTNodeBlock* node = arena_alloc(parser.arena, sizeof(ASTNodeBlock));
     node->base.type = AST_NODE_BLOCK;
     node->base.line = line;
     return (ASTNode*)node;
 }
 
 static ASTNode* make_node_import(int line, String* path, String* name) {
-    ASTNodeImport* node = malloc(sizeof(ASTNodeImport));
+    ASTNodeImport* node = arena_alloc(parser.arena, sizeof(ASTNodeImport));
     node->base.type = AST_NODE_IMPORT;
     node->base.line = line;
     node->path = path;
     node->name = name;
+    node->slot = -1;
     return (ASTNode*)node; 
 }
 
 static ASTNode* make_node_func_decl(int line, String* name, String** params, int param_count, ASTNode* body) {
-    ASTNodeFuncDecl* node = malloc(sizeof(ASTNodeFuncDecl));
+    ASTNodeFuncDecl* node = arena_alloc(parser.arena, sizeof(ASTNodeFuncDecl));
     node->base.type = AST_NODE_FUNC_DECL;
     node->base.line = line;
     node->name = name;
@@ -121,16 +127,17 @@ static ASTNode* make_node_func_decl(int line, String* name, String** params, int
 }
 
 static ASTNode* make_node_var_decl(int line, String* name, ASTNode* initializer) {
-    ASTNodeVarDecl* node = malloc(sizeof(ASTNodeVarDecl));
+    ASTNodeVarDecl* node = arena_alloc(parser.arena, sizeof(ASTNodeVarDecl));
     node->base.type = AST_NODE_VAR_DECL;
     node->base.line = line;
     node->name = name;
     node->initializer = initializer;
+    node->slot = -1;
     return (ASTNode*)node;
 }
 
 static ASTNode* make_node_expr_stmt(int line, ASTNode* expression) {
-    ASTNodeExprStmt* node = malloc(sizeof(ASTNodeExprStmt));
+    ASTNodeExprStmt* node = arena_alloc(parser.arena, sizeof(ASTNodeExprStmt));
     node->base.type = AST_NODE_EXPR_STMT;
     node->base.line = line;
     node->expression = expression;
@@ -138,7 +145,7 @@ static ASTNode* make_node_expr_stmt(int line, ASTNode* expression) {
 }
 
 static ASTNode* make_node_if_stmt(int line, ASTNode* condition, ASTNode* then_branch, ASTNode* else_branch) {
-    ASTNodeIfStmt* node = malloc(sizeof(ASTNodeIfStmt));
+    ASTNodeIfStmt* node = arena_alloc(parser.arena, sizeof(ASTNodeIfStmt));
     node->base.type = AST_NODE_IF_STMT;
     node->base.line = line;
     node->condition = condition;
@@ -148,7 +155,7 @@ static ASTNode* make_node_if_stmt(int line, ASTNode* condition, ASTNode* then_br
 }
 
 static ASTNode* make_node_while_stmt(int line, ASTNode* condition, ASTNode* body) {
-    ASTNodeWhileStmt* node = malloc(sizeof(ASTNodeWhileStmt));
+    ASTNodeWhileStmt* node = arena_alloc(parser.arena, sizeof(ASTNodeWhileStmt));
     node->base.type = AST_NODE_WHILE_STMT;
     node->base.line = line;
     node->condition = condition;
@@ -157,18 +164,30 @@ static ASTNode* make_node_while_stmt(int line, ASTNode* condition, ASTNode* body
 }
 
 static ASTNode* make_node_for_stmt(int line, ASTNode* initializer, ASTNode* condition, ASTNode* increment, ASTNode* body) {
-    ASTNodeForStmt* node = malloc(sizeof(ASTNodeForStmt));
+    ASTNodeForStmt* node = arena_alloc(parser.arena, sizeof(ASTNodeForStmt));
     node->base.type = AST_NODE_FOR_STMT;
     node->base.line = line;
     node->initializer = initializer;
     node->condition = condition;
     node->increment = increment;
     node->body = body;
+    node->local_count = 0;
+    return (ASTNode*)node;
+}
+
+static ASTNode* make_node_for_in_stmt(int line, String* name, ASTNode* iterable, ASTNode* body) {
+    ASTNodeForInStmt* node = arena_alloc(parser.arena, sizeof(ASTNodeForInStmt));
+    node->base.type = AST_NODE_FOR_IN_STMT;
+    node->base.line = line;
+    node->name = name;
+    node->iterable = iterable;
+    node->body = body;
+    node->slot = -1;
     return (ASTNode*)node;
 }
 
 static ASTNode* make_node_return_stmt(int line, ASTNode* expression) {
-    ASTNodeExprStmt* node = malloc(sizeof(ASTNodeExprStmt));
+    ASTNodeExprStmt* node = arena_alloc(parser.arena, sizeof(ASTNodeExprStmt));
     node->base.type = AST_NODE_RETURN_STMT;
     node->base.line = line;
     node->expression = expression;
@@ -176,21 +195,21 @@ static ASTNode* make_node_return_stmt(int line, ASTNode* expression) {
 }
 
 static ASTNode* make_node_break(int line) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = arena_alloc(parser.arena, sizeof(ASTNode));
     node->type = AST_NODE_BREAK;
     node->line = line;
     return node;
 }
 
 static ASTNode* make_node_continue(int line) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = arena_alloc(parser.arena, sizeof(ASTNode));
     node->type = AST_NODE_CONTINUE;
     node->line = line;
     return node;
 }
 
 static ASTNode* make_node_assignment(int line, ASTNode* target, TokenType op, ASTNode* value) {
-    ASTNodeAssignment* node = malloc(sizeof(ASTNodeAssignment));
+    ASTNodeAssignment* node = arena_alloc(parser.arena, sizeof(ASTNodeAssignment));
     node->base.type = AST_NODE_ASSIGNMENT;
     node->base.line = line;
     node->target = target;
@@ -200,7 +219,7 @@ static ASTNode* make_node_assignment(int line, ASTNode* target, TokenType op, AS
 }
 
 static ASTNode* make_node_ternary(int line, ASTNode* condition, ASTNode* then_branch, ASTNode* else_branch) {
-    ASTNodeIfStmt* node = malloc(sizeof(ASTNodeIfStmt));
+    ASTNodeIfStmt* node = arena_alloc(parser.arena, sizeof(ASTNodeIfStmt));
     node->base.type = AST_NODE_TERNARY;
     node->base.line = line;
     node->condition = condition;
@@ -210,7 +229,7 @@ static ASTNode* make_node_ternary(int line, ASTNode* condition, ASTNode* then_br
 }
 
 static ASTNode* make_node_logical(int line, ASTNode* left, TokenType op, ASTNode* right) {
-    ASTNodeBinary* node = malloc(sizeof(ASTNodeBinary));
+    ASTNodeBinary* node = arena_alloc(parser.arena, sizeof(ASTNodeBinary));
     node->base.type = AST_NODE_LOGICAL;
     node->base.line = line;
     node->left = left;
@@ -220,7 +239,7 @@ static ASTNode* make_node_logical(int line, ASTNode* left, TokenType op, ASTNode
 }
 
 static ASTNode* make_node_binary(int line, ASTNode* left, TokenType op, ASTNode* right) {
-    ASTNodeBinary* node = malloc(sizeof(ASTNodeBinary));
+    ASTNodeBinary* node = arena_alloc(parser.arena, sizeof(ASTNodeBinary));
     node->base.type = AST_NODE_BINARY;
     node->base.line = line;
     node->left = left;
@@ -230,7 +249,7 @@ static ASTNode* make_node_binary(int line, ASTNode* left, TokenType op, ASTNode*
 }
 
 static ASTNode* make_node_unary(int line, TokenType op, ASTNode* right) {
-    ASTNodeUnary* node = malloc(sizeof(ASTNodeUnary));
+    ASTNodeUnary* node = arena_alloc(parser.arena, sizeof(ASTNodeUnary));
     node->base.type = AST_NODE_UNARY;
     node->base.line = line;
     node->op = op;
@@ -239,7 +258,7 @@ static ASTNode* make_node_unary(int line, TokenType op, ASTNode* right) {
 }
 
 static ASTNode* make_node_call(int line, ASTNode* callee) {
-    ASTNodeCall* node = calloc(1, sizeof(ASTNodeCall));
+    ASTNodeCall* node = arena_alloc(parser.arena, sizeof(ASTNodeCall));
     node->base.type = AST_NODE_CALL;
     node->base.line = line;
     node->callee = callee;
@@ -247,7 +266,7 @@ static ASTNode* make_node_call(int line, ASTNode* callee) {
 }
 
 static ASTNode* make_node_subscription(int line, ASTNode* expression, ASTNode* index) {
-    ASTNodeSubscription* node = malloc(sizeof(ASTNodeSubscription));
+    ASTNodeSubscription* node = arena_alloc(parser.arena, sizeof(ASTNodeSubscription));
     node->base.type = AST_NODE_SUBSCRIPTION;
     node->base.line = line;
     node->expression = expression;
@@ -256,7 +275,7 @@ static ASTNode* make_node_subscription(int line, ASTNode* expression, ASTNode* i
 }
 
 static ASTNode* make_node_get(int line, ASTNode* object, String* name) {
-    ASTNodeGet* node = malloc(sizeof(ASTNodeGet));
+    ASTNodeGet* node = arena_alloc(parser.arena, sizeof(ASTNodeGet));
     node->base.type = AST_NODE_GET;
     node->base.line = line;
     node->object = object;
@@ -265,7 +284,7 @@ static ASTNode* make_node_get(int line, ASTNode* object, String* name) {
 }
 
 static ASTNode* make_node_literal(int line, Value value) {
-    ASTNodeLiteral* node = malloc(sizeof(ASTNodeLiteral));
+    ASTNodeLiteral* node = arena_alloc(parser.arena, sizeof(ASTNodeLiteral));
     node->base.type = AST_NODE_LITERAL;
     node->base.line = line;
     node->value = value;
@@ -273,20 +292,28 @@ static ASTNode* make_node_literal(int line, Value value) {
 }
 
 static ASTNode* make_node_var(int line, String* name) {
-    ASTNodeVar* node = malloc(sizeof(ASTNodeVar));
+    ASTNodeVar* node = arena_alloc(parser.arena, sizeof(ASTNodeVar));
     node->base.type = AST_NODE_VAR;
     node->base.line = line;
     node->name = name;
+    node->slot = -1;
     return (ASTNode*)node;
 }
 
 static ASTNode* make_node_list(int line) {
-    ASTNodeList* node = calloc(1, sizeof(ASTNodeList));
+    ASTNodeList* node = arena_alloc(parser.arena, sizeof(ASTNodeList));
     node->base.type = AST_NODE_LIST;
     node->base.line = line;
     return (ASTNode*)node;
 }
 
+static ASTNode* make_node_map(int line) {
+    ASTNodeMap* node = arena_alloc(parser.arena, sizeof(ASTNodeMap));
+    node->base.type = AST_NODE_MAP;
+    node->base.line = line;
+    return (ASTNode*)node;
+}
+
 static ASTNode* parse_program();
 static ASTNode* parse_global_declaration();
 static ASTNode* parse_local_declaration();
@@ -298,6 +325,7 @@ static ASTNode* parse_expression_statement();
 static ASTNode* parse_if_statement();
 static ASTNode* parse_while_statement();
 static ASTNode* parse_for_statement();
+static ASTNode* parse_for_in_statement(int line, String* name);
 static ASTNode* parse_return_statement();
 static ASTNode* parse_block();
 
@@ -314,14 +342,16 @@ static ASTNode* parse_unary();
 static ASTNode* parse_call();
 static ASTNode* parse_primary();
 static ASTNode* parse_list();
+static ASTNode* parse_map();
 
 static ASTNode* parse_program() {
     ASTNodeBlock* block = (ASTNodeBlock*)make_node_program();
     while (parser.current.type != TOKEN_EOF) {
 
         if (block->capacity < block->count + 1) {
-            block->capacity = GROW_CAPACITY(block->capacity);
-            block->statements = GROW_ARRAY(ASTNode*, block->statements, block->capacity);
+            int old_capacity = block->capacity;
+            block->capacity = GROW_CAPACITY(old_capacity);
+            block->statements = ARENA_GROW_ARRAY(parser.arena, ASTNode*, block->statements, old_capacity, block->capacity);
         }
         block->statements[block->count++] = parse_global_declaration();
     }
@@ -386,14 +416,15 @@ static ASTNode* parse_function_declaration() {
 
     // function parameters
     consume_expected(TOKEN_LEFT_PAREN, "expected '(' after function name");
-    String** params = calloc(1, sizeof(String*));
+    String** params = NULL;
     int param_count = 0;
     int param_capacity = 0;
     if (parser.current.type != TOKEN_RIGHT_PAREN) {
         do {
             if (param_capacity < param_count + 1) {
-                param_capacity = GROW_CAPACITY(param_capacity);
-                params = GROW_ARRAY(String*, params, param_capacity);
+                int old_capacity = param_capacity;
+                param_capacity = GROW_CAPACITY(old_capacity);
+                params = ARENA_GROW_ARRAY(parser.arena, String*, params, old_capacity, param_capacity);
             }
             consume_expected(TOKEN_IDENTIFIER, "expected parameter name");
             String* param = string_new(parser.previous.value, parser.previous.length);
@@ -517,7 +548,14 @@ static ASTNode* parse_for_statement() {
         initializer = parse_variable_declaration();
     }
     else {
-        initializer = parse_expression_statement();
+        // 'for (x in ...)' starts like expression statement, until 'in' follows the variable
+        ASTNode* expression = parse_expression();
+        if (expression != NULL && expression->type == AST_NODE_VAR && match(1, TOKEN_IN)) {
+            return parse_for_in_statement(line, ((ASTNodeVar*)expression)->name);
+        }
+        int expression_line = parser.previous.line;
+        consume_expected(TOKEN_SEMICOLON, "expected ';' after expression");
+        initializer = make_node_expr_stmt(expression_line, expression);
     }
 
     ASTNode* condition = NULL;
@@ -541,6 +579,13 @@ static ASTNode* parse_for_statement() {
     return make_node_for_stmt(line, initializer, condition, increment, body);
 }
 
+static ASTNode* parse_for_in_statement(int line, String* name) {
+    ASTNode* iterable = parse_expression();
+    consume_expected(TOKEN_RIGHT_PAREN, "expected ')' after iterated expression");
+    ASTNode* body = parse_statement();
+    return make_node_for_in_stmt(line, name, iterable, body);
+}
+
 static ASTNode* parse_return_statement() {
     int line = parser.previous.line;
     ASTNode* expression = NULL;
@@ -555,8 +600,9 @@ static ASTNode* parse_block() {
     ASTNodeBlock* block = (ASTNodeBlock*)make_node_block(parser.previous.line);
     while (parser.current.type != TOKEN_RIGHT_BRACE && parser.current.type != TOKEN_EOF) {
         if (block->capacity < block->count + 1) {
-            block->capacity = GROW_CAPACITY(block->capacity);
-            block->statements = GROW_ARRAY(ASTNode*, block->statements, block->capacity);
+            int old_capacity = block->capacity;
+            block->capacity = GROW_CAPACITY(old_capacity);
+            block->statements = ARENA_GROW_ARRAY(parser.arena, ASTNode*, block->statements, old_capacity, block->capacity);
         }
         block->statements[block->count++] = parse_local_declaration();
     }
@@ -675,8 +721,9 @@ static ASTNode* finish_call(ASTNode* callee) {
     if (parser.current.type != TOKEN_RIGHT_PAREN) {
         do {
             if (call->capacity < call->count + 1) {
-                call->capacity = GROW_CAPACITY(call->capacity);
-                call->arguments = GROW_ARRAY(ASTNode*, call->arguments, call->capacity);
+                int old_capacity = call->capacity;
+                call->capacity = GROW_CAPACITY(old_capacity);
+                call->arguments = ARENA_GROW_ARRAY(parser.arena, ASTNode*, call->arguments, old_capacity, call->capacity);
             }
             call->arguments[call->count++] = parse_expression();
         } while (match(1, TOKEN_COMMA));
@@ -718,6 +765,17 @@ static ASTNode* parse_call() {
     return expr;
 }
 
+// source is mapped without terminating NUL, so number is converted from a terminated copy
+static void number_text(char* text) {
+    int length = parser.previous.length;
+    if (length > NUMBER_MAX_LENGTH) {
+        error_at(parser.previous, "number literal is too long");
+        length = 0;
+    }
+    memcpy(text, parser.previous.value, length);
+    text[length] = '\0';
+}
+
 static ASTNode* parse_primary() {
     int line = parser.current.line;
     if (match(1, TOKEN_IDENTIFIER)) {
@@ -725,12 +783,20 @@ static ASTNode* parse_primary() {
         return make_node_var(line, name);
     }
     if (match(1, TOKEN_INT)) {
-        int64_t value = strtoll(parser.previous.value, NULL, 10);
+        char text[NUMBER_MAX_LENGTH + 1];
+        number_text(text);
+        errno = 0;
+        int64_t value = strtoll(text, NULL, 10);
+        if (errno == ERANGE || !int_fits(value)) {
+            error_at(parser.previous, "integer literal out of range");
+        }
         return make_node_literal(line, INT_VALUE(value));
     }
     if (match(1, TOKEN_FLOAT)) {
         int line = parser.previous.line;
-        double value = strtod(parser.previous.value, NULL);
+        char text[NUMBER_MAX_LENGTH + 1];
+        number_text(text);
+        double value = strtod(text, NULL);
         return make_node_literal(line, FLOAT_VALUE(value));
     }
     if (match(1, TOKEN_STRING)) {
@@ -756,6 +822,11 @@ static ASTNode* parse_primary() {
         consume_expected(TOKEN_RIGHT_BRACKET, "expected closing bracket");
         return list;
     }
+    if (match(1, TOKEN_LEFT_BRACE)) {
+        ASTNode* map = parse_map();
+        consume_expected(TOKEN_RIGHT_BRACE, "expected closing brace");
+        return map;
+    }
 
     error_at(parser.current, "unexpected value");
     advance();
@@ -772,8 +843,9 @@ static ASTNode* parse_list() {
 
     do {
         if (list->capacity < list->count + 1) {
-            list->capacity = GROW_CAPACITY(list->capacity);
-            list->expressions = GROW_ARRAY(ASTNode*, list->expressions, list->capacity);
+            int old_capacity = list->capacity;
+            list->capacity = GROW_CAPACITY(old_capacity);
+            list->expressions = ARENA_GROW_ARRAY(parser.arena, ASTNode*, list->expressions, old_capacity, list->capacity);
         }
         list->expressions[list->count++] = parse_ternary();
     } while (match(1, TOKEN_COMMA));
@@ -781,123 +853,41 @@ static ASTNode* parse_list() {
     return (ASTNode*)list;
 }
 
-bool parser_parse(const char* source, ASTNode** output) {
-    lexer_init(source);
+static ASTNode* parse_map() {
+    int line = parser.previous.line;
+    ASTNodeMap* map = (ASTNodeMap*)make_node_map(line);
+
+    if (parser.current.type == TOKEN_RIGHT_BRACE) {
+        return (ASTNode*)map;
+    }
+
+    do {
+        if (map->capacity < map->count + 1) {
+            int old_capacity = map->capacity;
+            map->capacity = GROW_CAPACITY(old_capacity);
+            map->keys = ARENA_GROW_ARRAY(parser.arena, ASTNode*, map->keys, old_capacity, map->capacity);
+            map->values = ARENA_GROW_ARRAY(parser.arena, ASTNode*, map->values, old_capacity, map->capacity);
+        }
+        map->keys[map->count] = parse_ternary();
+        consume_expected(TOKEN_COLON, "expected ':' after map key");
+        map->values[map->count++] = parse_ternary();
+    } while (match(1, TOKEN_COMMA));
+
+    return (ASTNode*)map;
+}
+
+bool parser_parse(const char* source, size_t length, Arena* arena, ASTNode** output) {
+    lexer_init(source, length);
 
     parser.had_error = false;
     parser.panic_mode = false;
-    advance();
+    parser.arena = arena;
 
+    // strings referenced by AST must outlive any garbage collection
+    gc_pin_begin();
+    advance();
     *output = parse_program();
+    gc_pin_end();
 
     return !parser.had_error;
 }
-
-void parser_free_ast(ASTNode* root) {
-    switch (root->type) {
-        case AST_NODE_PROGRAM:
-        case AST_NODE_BLOCK: {
-            ASTNodeBlock* block = (ASTNodeBlock*)root;
-            for (int i = 0; i < block->count; ++i) {
-                parser_free_ast(block->statements[i]);
-            }
-            free(block->statements);
-        } break;
-        case AST_NODE_IMPORT: break;
-        case AST_NODE_FUNC_DECL: {
-            ASTNodeFuncDecl* func_decl = (ASTNodeFuncDecl*)root;
-            for (int i = 0; i < func_decl->param_count; ++i) {
-                free(func_decl->params[i]);
-            }
-            free(func_decl->params);
-            parser_free_ast(func_decl->body);
-        } break;
-        case AST_NODE_VAR_DECL: {
-            ASTNodeVarDecl* var_decl = (ASTNodeVarDecl*)root;
-            parser_free_ast(var_decl->initializer);
-        } break;
-        case AST_NODE_EXPR_STMT: {
-            ASTNodeExprStmt* expr_stmt = (ASTNodeExprStmt*)root;
-            parser_free_ast(expr_stmt->expression);
-        } break;
-        case AST_NODE_TERNARY:
-        case AST_NODE_IF_STMT: {
-            ASTNodeIfStmt* if_stmt = (ASTNodeIfStmt*)root;
-            parser_free_ast(if_stmt->condition);
-            parser_free_ast(if_stmt->then_branch);
-            if (if_stmt->else_branch != NULL) {
-                parser_free_ast(if_stmt->else_branch);
-            }
-        } break;
-        case AST_NODE_WHILE_STMT: {
-            ASTNodeWhileStmt* while_stmt = (ASTNodeWhileStmt*)root;
-            parser_free_ast(while_stmt->condition);
-            if (while_stmt->body != NULL) {
-                parser_free_ast(while_stmt->body);
-            }
-        } break;
-        case AST_NODE_FOR_STMT: {
-            ASTNodeForStmt* for_stmt = (ASTNodeForStmt*)root;
-            if (for_stmt->initializer != NULL) {
-                parser_free_ast(for_stmt->initializer);
-            }
-            if (for_stmt->increment != NULL) {
-                parser_free_ast(for_stmt->increment);
-            }
-            if (for_stmt->body != NULL) {
-                parser_free_ast(for_stmt->body);
-            }
-        } break;
-        case AST_NODE_RETURN_STMT: {
-            ASTNodeExprStmt* return_stmt = (ASTNodeExprStmt*)root;
-            if (return_stmt->expression != NULL) {
-                parser_free_ast(return_stmt->expression);
-            }
-        } break;
-        case AST_NODE_BREAK: break;
-        case AST_NODE_CONTINUE: break;
-        case AST_NODE_ASSIGNMENT: {
-            ASTNodeAssignment* assignment = (ASTNodeAssignment*)root;
-            parser_free_ast(assignment->target);
-            parser_free_ast(assignment->value);
-        } break;
-        case AST_NODE_LOGICAL:
-        case AST_NODE_BINARY: {
-            ASTNodeBinary* binary = (ASTNodeBinary*)root;
-            parser_free_ast(binary->left);
-            parser_free_ast(binary->right);
-        } break;
-        case AST_NODE_UNARY: {
-            ASTNodeUnary* unary = (ASTNodeUnary*)root;
-            parser_free_ast(unary->right);
-        } break;
-        case AST_NODE_CALL: {
-            ASTNodeCall* call = (ASTNodeCall*)root;
-            parser_free_ast(call->callee);
-            for (int i = 0; i < call->count; ++i) {
-                parser_free_ast(call->arguments[i]);
-            }
-            free(call->arguments);
-        } break;
-        case AST_NODE_GET: {
-            ASTNodeGet* get = (ASTNodeGet*)root;
-            parser_free_ast(get->object);
-        } break;
-        case AST_NODE_SUBSCRIPTION: {
-            ASTNodeSubscription* subscription = (ASTNodeSubscription*)root;
-            parser_free_ast(subscription->expression);
-            parser_free_ast(subscription->index);
-        } break;
-        case AST_NODE_LITERAL: break;
-        case AST_NODE_VAR: break;
-        case AST_NODE_LIST: {
-            ASTNodeList* list = (ASTNodeList*)root;
-            for (int i = 0; i < list->count; ++i) {
-                parser_free_ast(list->expressions[i]);
-            }
-            free(list->expressions);
-            // FIXME list value isn't freed
-        }
-    }
-    free(root);
-}
@@ -0,0 +1,306 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "error.h"
+#include "memory.h"
+#include "profiler.h"
+
+// node of call tree, one for every distinct stack of functions seen in samples
+typedef struct {
+    Function* function;  // NULL for main program
+    int parent;
+    int first_child;
+    int next_sibling;
+    long samples;        // samples taken while this node was on top of the stack
+} ProfileNode;
+
+// samples taken on given line of given function
+typedef struct {
+    Function* function;
+    int line;
+    long samples;
+} ProfileLine;
+
+typedef struct {
+    Function* function;
+    long self;
+    long total;
+} ProfileFunction;
+
+volatile sig_atomic_t profiler_ticks = 0;
+bool profiler_running = false;
+
+static const char* output_path = NULL;
+static long total_samples = 0;
+
+static Function* call_stack[PROFILER_STACK_MAX];  // active user function calls, outermost first
+static int call_depth = 0;
+
+static ProfileNode* nodes = NULL;
+static int node_count = 0;
+static int node_capacity = 0;
+
+static ProfileLine* lines = NULL;  // hash table keyed by function and line
+static int line_count = 0;
+static int line_capacity = 0;
+
+static void handle_tick(int signal) {
+    (void)signal;
+    ++profiler_ticks;
+}
+
+static int node_add(Function* function, int parent) {
+    if (node_count + 1 > node_capacity) {
+        node_capacity = GROW_CAPACITY(node_capacity);
+        nodes = GROW_ARRAY(ProfileNode, nodes, node_capacity);
+    }
+    ProfileNode* node = &nodes[node_count];
+    node->function = function;
+    node->parent = parent;
+    node->first_child = -1;
+    node->next_sibling = -1;
+    node->samples = 0;
+    if (parent >= 0) {
+        node->next_sibling = nodes[parent].first_child;
+        nodes[parent].first_child = node_count;
+    }
+    return node_count++;
+}
+
+static int node_child(int parent, Function* function) {
+    for (int child = nodes[parent].first_child; child >= 0; child = nodes[child].next_sibling) {
+        if (nodes[child].function == function) return child;
+    }
+    return node_add(function, parent);
+}
+
+static unsigned line_hash(Function* function, int line) {
+    uintptr_t key = (uintptr_t)function ^ ((uintptr_t)line * 2654435761u);
+    return (unsigned)(key ^ (key >> 16));
+}
+
+static ProfileLine* line_find(ProfileLine* entries, int capacity, Function* function, int line) {
+    unsigned index = line_hash(function, line) & (capacity - 1);
+    for (;;) {
+        ProfileLine* entry = &entries[index];
+        if (entry->samples == 0 || (entry->function == function && entry->line == line)) {
+            return entry;
+        }
+        index = (index + 1) & (capacity - 1);
+    }
+}
+
+static void line_add(Function* function, int line, long samples) {
+    if (line_count + 1 > line_capacity * 3 / 4) {
+        int capacity = line_capacity < 64 ? 64 : line_capacity * 2;
+        ProfileLine* entries = calloc(capacity, sizeof(ProfileLine));
+        for (int i = 0; i < line_capacity; ++i) {
+            if (lines[i].samples == 0) continue;
+            *line_find(entries, capacity, lines[i].function, lines[i].line) = lines[i];
+        }
+        free(lines);
+        lines = entries;
+        line_capacity = capacity;
+    }
+    ProfileLine* entry = line_find(lines, line_capacity, function, line);
+    if (entry->samples == 0) {
+        entry->function = function;
+        entry->line = line;
+        ++line_count;
+    }
+    entry->samples += samples;
+}
+
+static const char* function_name(Function* function) {
+    return function == NULL ? "<main>" : function->name->data;
+}
+
+void profiler_start(const char* path) {
+    output_path = path;
+    node_add(NULL, -1);
+    profiler_running = true;
+    atexit(profiler_stop);  // runtime errors exit without returning to main
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_tick;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, NULL);
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = PROFILER_INTERVAL_US;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+void profiler_enter(Function* function) {
+    if (call_depth < PROFILER_STACK_MAX) {
+        call_stack[call_depth] = function;
+    }
+    ++call_depth;
+}
+
+void profiler_leave() {
+    --call_depth;
+}
+
+void profiler_sample() {
+    // ticks that arrived since the previous sample are all attributed to this one
+    long ticks = profiler_ticks;
+    profiler_ticks = 0;
+    if (!profiler_running || ticks == 0) return;
+
+    int depth = call_depth < PROFILER_STACK_MAX ? call_depth : PROFILER_STACK_MAX;
+    int node = 0;
+    for (int i = 0; i < depth; ++i) {
+        node = node_child(node, call_stack[i]);
+    }
+    nodes[node].samples += ticks;
+    line_add(nodes[node].function, current_line, ticks);
+    total_samples += ticks;
+}
+
+void profiler_mark_roots() {
+    // reported functions must outlive their calls
+    for (int i = 1; i < node_count; ++i) {
+        gc_mark_object((Obj*)nodes[i].function);
+    }
+}
+
+static int compare_functions(const void* a, const void* b) {
+    long difference = ((const ProfileFunction*)b)->self - ((const ProfileFunction*)a)->self;
+    return difference > 0 ? 1 : difference < 0 ? -1 : 0;
+}
+
+static int compare_lines(const void* a, const void* b) {
+    long difference = ((const ProfileLine*)b)->samples - ((const ProfileLine*)a)->samples;
+    return difference > 0 ? 1 : difference < 0 ? -1 : 0;
+}
+
+static double percent(long samples) {
+    return total_samples == 0 ? 0.0 : 100.0 * samples / total_samples;
+}
+
+static void write_report(FILE* file) {
+    // children are always added after their parent
+    long* inclusive = calloc(node_count, sizeof(long));
+    for (int i = node_count - 1; i >= 0; --i) {
+        inclusive[i] += nodes[i].samples;
+        if (nodes[i].parent >= 0) inclusive[nodes[i].parent] += inclusive[i];
+    }
+
+    ProfileFunction* functions = calloc(node_count, sizeof(ProfileFunction));
+    int function_count = 0;
+    for (int i = 0; i < node_count; ++i) {
+        ProfileFunction* entry = NULL;
+        for (int j = 0; j < function_count; ++j) {
+            if (functions[j].function == nodes[i].function) {
+                entry = &functions[j];
+                break;
+            }
+        }
+        if (entry == NULL) {
+            entry = &functions[function_count++];
+            entry->function = nodes[i].function;
+        }
+        entry->self += nodes[i].samples;
+
+        // recursive calls are counted once, at the outermost one
+        bool outermost = true;
+        for (int parent = nodes[i].parent; parent >= 0; parent = nodes[parent].parent) {
+            if (nodes[parent].function == nodes[i].function) {
+                outermost = false;
+                break;
+            }
+        }
+        if (outermost) entry->total += inclusive[i];
+    }
+    qsort(functions, function_count, sizeof(ProfileFunction), compare_functions);
+
+    fprintf(file, "%ld samples, %d us interval\n\n", total_samples, PROFILER_INTERVAL_US);
+    fprintf(file, "%8s %8s %8s %8s  %s\n", "self%", "self", "total%", "total", "function");
+    for (int i = 0; i < function_count; ++i) {
+        ProfileFunction* entry = &functions[i];
+        fprintf(file, "%7.2f%% %8ld %7.2f%% %8ld  %s\n",
+                percent(entry->self), entry->self, percent(entry->total), entry->total,
+                function_name(entry->function));
+    }
+
+    ProfileLine* sorted = malloc(sizeof(ProfileLine) * (line_count + 1));
+    int sorted_count = 0;
+    for (int i = 0; i < line_capacity; ++i) {
+        if (lines[i].samples > 0) sorted[sorted_count++] = lines[i];
+    }
+    qsort(sorted, sorted_count, sizeof(ProfileLine), compare_lines);
+
+    fprintf(file, "\n%8s %8s  %s\n", "self%", "self", "line");
+    for (int i = 0; i < sorted_count; ++i) {
+        fprintf(file, "%7.2f%% %8ld  %s:%d\n",
+                percent(sorted[i].samples), sorted[i].samples,
+                function_name(sorted[i].function), sorted[i].line);
+    }
+
+    free(sorted);
+    free(functions);
+    free(inclusive);
+}
+
+// one line per stack: frames separated by ';' and number of samples
+static void write_folded(FILE* file) {
+    int* path = malloc(sizeof(int) * node_count);
+    for (int i = 0; i < node_count; ++i) {
+        if (nodes[i].samples == 0) continue;
+
+        int depth = 0;
+        for (int node = i; node >= 0; node = nodes[node].parent) {
+            path[depth++] = node;
+        }
+        for (int j = depth - 1; j >= 0; --j) {
+            fprintf(file, "%s%c", function_name(nodes[path[j]].function), j > 0 ? ';' : ' ');
+        }
+        fprintf(file, "%ld\n", nodes[i].samples);
+    }
+    free(path);
+}
+
+void profiler_stop() {
+    if (!profiler_running) return;
+    profiler_running = false;
+
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+
+    FILE* file = fopen(output_path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "profiler::profiler_stop: failed to open file: %s\n", output_path);
+    }
+    else {
+        write_report(file);
+        fclose(file);
+    }
+
+    char* folded_path = malloc(strlen(output_path) + sizeof(".folded"));
+    strcpy(folded_path, output_path);
+    strcat(folded_path, ".folded");
+    file = fopen(folded_path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "profiler::profiler_stop: failed to open file: %s\n", folded_path);
+    }
+    else {
+        write_folded(file);
+        fclose(file);
+    }
+    free(folded_path);
+
+    free(nodes);
+    free(lines);
+    nodes = NULL;
+    lines = NULL;
+    node_count = node_capacity = 0;
+    line_count = line_capacity = 0;
+}
@@ -0,0 +1,277 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "memory.h"
+#include "parser.h"
+#include "resolver.h"
+#include "value.h"
+
+typedef struct Scope {
+    struct Scope* enclosing;
+    bool is_function;  // variables of enclosing scopes are not visible in function
+    int first_slot;    // slot of first variable declared in scope, relative to call frame
+    int local_count;   // number of variables declared directly in scope
+    String** names;
+    int count;
+    int capacity;
+} Scope;
+
+static Scope* current_scope = NULL;
+static int function_depth = 0;  // return is only valid inside function
+static int loop_depth = 0;      // break and continue are only valid inside loop
+static bool had_error = false;
+
+static void resolve_error(int line, const char* format, ...) {
+    had_error = true;
+    fprintf(stderr, "[line %d] error: ", line);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputs("\n", stderr);
+}
+
+static void begin_scope(Scope* scope, bool is_function, int local_count) {
+    scope->enclosing = current_scope;
+    scope->is_function = is_function;
+    scope->first_slot = 0;
+    if (!is_function && current_scope != NULL) {
+        scope->first_slot = current_scope->first_slot + current_scope->local_count;
+    }
+    scope->local_count = local_count;
+    scope->names = NULL;
+    scope->count = 0;
+    scope->capacity = 0;
+    current_scope = scope;
+}
+
+static int end_scope() {
+    int count = current_scope->count;
+    free(current_scope->names);
+    current_scope = current_scope->enclosing;
+    return count;
+}
+
+// returns slot of declared variable or -1 if it's global
+static int declare(String* name, int line) {
+    if (current_scope == NULL) return -1;
+
+    for (int i = 0; i < current_scope->count; ++i) {
+        if (current_scope->names[i] == name) {
+            resolve_error(line, "redeclaration of variable '%s'", name->data);
+            return current_scope->first_slot + i;
+        }
+    }
+
+    if (current_scope->capacity < current_scope->count + 1) {
+        current_scope->capacity = GROW_CAPACITY(current_scope->capacity);
+        current_scope->names = GROW_ARRAY(String*, current_scope->names, current_scope->capacity);
+    }
+    current_scope->names[current_scope->count] = name;
+    return current_scope->first_slot + current_scope->count++;
+}
+
+static bool is_declaration(ASTNode* node) {
+    if (node == NULL) return false;
+    if (node->type == AST_NODE_VAR_DECL) return true;
+    return node->type == AST_NODE_IMPORT && ((ASTNodeImport*)node)->name != NULL;
+}
+
+// all variables of a scope are carved out of the stack when the scope is entered,
+// so nested scopes have to start after the last variable of the enclosing one
+static int count_declarations(ASTNodeBlock* block) {
+    int count = 0;
+    for (int i = 0; i < block->count; ++i) {
+        if (is_declaration(block->statements[i])) ++count;
+    }
+    return count;
+}
+
+// globals live in a table of environment, which is sized for all of them up front
+static int count_globals(ASTNodeBlock* program) {
+    int count = 0;
+    for (int i = 0; i < program->count; ++i) {
+        ASTNode* statement = program->statements[i];
+        if (is_declaration(statement) || statement->type == AST_NODE_FUNC_DECL) ++count;
+    }
+    return count;
+}
+
+static void resolve_variable(ASTNodeVar* var) {
+    for (Scope* scope = current_scope; scope != NULL; scope = scope->enclosing) {
+        // names are interned, so pointer comparison is enough
+        for (int i = scope->count - 1; i >= 0; --i) {
+            if (scope->names[i] == var->name) {
+                var->slot = scope->first_slot + i;
+                return;
+            }
+        }
+        if (scope->is_function) break;
+    }
+    var->slot = -1;
+}
+
+static void resolve(ASTNode* root) {
+    if (root == NULL) return;
+
+    switch (root->type) {
+        case AST_NODE_PROGRAM: {
+            ASTNodeBlock* block = (ASTNodeBlock*)root;
+            for (int i = 0; i < block->count; ++i) {
+                resolve(block->statements[i]);
+            }
+            block->local_count = count_globals(block);
+        } break;
+        case AST_NODE_BLOCK: {
+            ASTNodeBlock* block = (ASTNodeBlock*)root;
+            Scope scope;
+            begin_scope(&scope, false, count_declarations(block));
+            for (int i = 0; i < block->count; ++i) {
+                resolve(block->statements[i]);
+            }
+            block->local_count = end_scope();
+        } break;
+        case AST_NODE_IMPORT: {
+            ASTNodeImport* import = (ASTNodeImport*)root;
+            if (import->name != NULL) {
+                import->slot = declare(import->name, root->line);
+            }
+        } break;
+        case AST_NODE_FUNC_DECL: {
+            ASTNodeFuncDecl* func_decl = (ASTNodeFuncDecl*)root;
+            Scope scope;
+            begin_scope(&scope, true, func_decl->param_count);
+            for (int i = 0; i < func_decl->param_count; ++i) {
+                declare(func_decl->params[i], root->line);
+            }
+            int enclosing_loop_depth = loop_depth;
+            loop_depth = 0;
+            ++function_depth;
+            resolve(func_decl->body);
+            --function_depth;
+            loop_depth = enclosing_loop_depth;
+            end_scope();
+        } break;
+        case AST_NODE_VAR_DECL: {
+            ASTNodeVarDecl* var_decl = (ASTNodeVarDecl*)root;
+            resolve(var_decl->initializer);
+            var_decl->slot = declare(var_decl->name, root->line);
+        } break;
+        case AST_NODE_RETURN_STMT: {
+            if (function_depth == 0) {
+                resolve_error(root->line, "'return' is only allowed inside functions");
+            }
+            ASTNodeExprStmt* return_stmt = (ASTNodeExprStmt*)root;
+            resolve(return_stmt->expression);
+        } break;
+        case AST_NODE_EXPR_STMT: {
+            ASTNodeExprStmt* expr_stmt = (ASTNodeExprStmt*)root;
+            resolve(expr_stmt->expression);
+        } break;
+        case AST_NODE_TERNARY:
+        case AST_NODE_IF_STMT: {
+            ASTNodeIfStmt* if_stmt = (ASTNodeIfStmt*)root;
+            resolve(if_stmt->condition);
+            resolve(if_stmt->then_branch);
+            resolve(if_stmt->else_branch);
+        } break;
+        case AST_NODE_WHILE_STMT: {
+            ASTNodeWhileStmt* while_stmt = (ASTNodeWhileStmt*)root;
+            resolve(while_stmt->condition);
+            ++loop_depth;
+            resolve(while_stmt->body);
+            --loop_depth;
+        } break;
+        case AST_NODE_FOR_STMT: {
+            ASTNodeForStmt* for_stmt = (ASTNodeForStmt*)root;
+            Scope scope;
+            begin_scope(&scope, false, is_declaration(for_stmt->initializer) ? 1 : 0);
+            resolve(for_stmt->initializer);
+            resolve(for_stmt->condition);
+            resolve(for_stmt->increment);
+            ++loop_depth;
+            resolve(for_stmt->body);
+            --loop_depth;
+            for_stmt->local_count = end_scope();
+        } break;
+        case AST_NODE_FOR_IN_STMT: {
+            ASTNodeForInStmt* for_in = (ASTNodeForInStmt*)root;
+            resolve(for_in->iterable);
+            Scope scope;
+            begin_scope(&scope, false, 2);
+            declare(NULL, root->line);  // iterated list or map, invisible to program
+            for_in->slot = declare(for_in->name, root->line);
+            ++loop_depth;
+            resolve(for_in->body);
+            --loop_depth;
+            end_scope();
+        } break;
+        case AST_NODE_BREAK: {
+            if (loop_depth == 0) {
+                resolve_error(root->line, "'break' is only allowed inside loops");
+            }
+        } break;
+        case AST_NODE_CONTINUE: {
+            if (loop_depth == 0) {
+                resolve_error(root->line, "'continue' is only allowed inside loops");
+            }
+        } break;
+        case AST_NODE_ASSIGNMENT: {
+            ASTNodeAssignment* assignment = (ASTNodeAssignment*)root;
+            resolve(assignment->target);
+            resolve(assignment->value);
+        } break;
+        case AST_NODE_LOGICAL:
+        case AST_NODE_BINARY: {
+            ASTNodeBinary* binary = (ASTNodeBinary*)root;
+            resolve(binary->left);
+            resolve(binary->right);
+        } break;
+        case AST_NODE_UNARY: {
+            ASTNodeUnary* unary = (ASTNodeUnary*)root;
+            resolve(unary->right);
+        } break;
+        case AST_NODE_CALL: {
+            ASTNodeCall* call = (ASTNodeCall*)root;
+            resolve(call->callee);
+            for (int i = 0; i < call->count; ++i) {
+                resolve(call->arguments[i]);
+            }
+        } break;
+        case AST_NODE_GET: {
+            ASTNodeGet* get = (ASTNodeGet*)root;
+            resolve(get->object);
+        } break;
+        case AST_NODE_SUBSCRIPTION: {
+            ASTNodeSubscription* subscription = (ASTNodeSubscription*)root;
+            resolve(subscription->expression);
+            resolve(subscription->index);
+        } break;
+        case AST_NODE_LITERAL: break;
+        case AST_NODE_VAR: {
+            resolve_variable((ASTNodeVar*)root);
+        } break;
+        case AST_NODE_LIST: {
+            ASTNodeList* list = (ASTNodeList*)root;
+            for (int i = 0; i < list->count; ++i) {
+                resolve(list->expressions[i]);
+            }
+        } break;
+        case AST_NODE_MAP: {
+            ASTNodeMap* map = (ASTNodeMap*)root;
+            for (int i = 0; i < map->count; ++i) {
+                resolve(map->keys[i]);
+                resolve(map->values[i]);
+            }
+        } break;
+    }
+}
+
+bool resolver_resolve(ASTNode* root) {
+    had_error = false;
+    current_scope = NULL;
+    function_depth = 0;
+    loop_depth = 0;
+    resolve(root);
+    return !had_error;
+}
@@ -3,29 +3,36 @@
 #include "strings.h"
 #include "hash.h"
 #include "hashmap.h"
+#include "memory.h"
 #include "value.h"
 
 typedef struct {
     String** entries;
-    int count;
+    int count;  // includes tombstones
     int capacity;
 } StringTable;
 
 static StringTable strings = { 0 };
 
+// marks entry of collected string, so probing continues past it
+static String tombstone = { 0 };
+#define TOMBSTONE (&tombstone)
+
 static void resize(int new_capacity) {
     String** new_entries = calloc(new_capacity, sizeof(String*));
+    strings.count = 0;
 
     for (int i = 0; i < strings.capacity; ++i) {
         String* entry = strings.entries[i];
-        if (entry != NULL) {
-            int index = entry->hash % new_capacity;
+        if (entry != NULL && entry != TOMBSTONE) {
+            int index = entry->hash & (new_capacity - 1);
 
             while (new_entries[index] != NULL) {
-                index = (index + 1) % new_capacity;
+                index = (index + 1) & (new_capacity - 1);
             }
 
             new_entries[index] = entry;
+            ++strings.count;
         }
     }
 
@@ -35,19 +42,15 @@ static void resize(int new_capacity) {
 }
 
 void interned_strings_init() {
-    strings.entries = calloc(HASHMAP_INITIAL_CAPACITY, sizeof(StringTable));
+    strings.entries = calloc(HASHMAP_INITIAL_CAPACITY, sizeof(String*));
     strings.capacity = HASHMAP_INITIAL_CAPACITY;
     strings.count = 0;
 }
 
+// strings themselves are freed by garbage collector
 void interned_strings_free() {
-    for (int i = 0; i < strings.capacity; ++i) {
-        if (strings.entries[i] != NULL) {
-            free(strings.entries[i]);
-        }
-    }
     free(strings.entries);
-    
+
     strings.entries = NULL;
     strings.capacity = 0;
     strings.count = 0;
@@ -60,21 +63,38 @@ String* intern_string(const char* data, int length) {
 
     Hash hash = hash_cstring(data, length);
 
-    int index = hash % strings.capacity;
+    int index = hash & (strings.capacity - 1);
+    int insert_index = -1;
     String* entry = NULL;
     while ((entry = strings.entries[index]) != NULL) {
-        if (entry->length == length && memcmp(entry->data, data, length) == 0) {
+        if (entry == TOMBSTONE) {
+            if (insert_index == -1) insert_index = index;
+        }
+        else if (entry->length == length && memcmp(entry->data, data, length) == 0) {
             // printf("[DEBUG] Found interned string. Current count: %d. String: \"%s\"\n", strings.count, entry->data);
+            if (gc_pinning()) entry->obj.pinned = true;
             return entry;  // found interned string
         }
-        index = (index + 1) % strings.capacity;
+        index = (index + 1) & (strings.capacity - 1);
     }
 
-    // not found - create new string
+    // not found - create new string, reusing tombstone if there was one
     String* string = string_create(length, hash, data);
-    strings.entries[index] = string;
-    ++strings.count;
+    if (insert_index == -1) {
+        insert_index = index;
+        ++strings.count;
+    }
+    strings.entries[insert_index] = string;
 
     // printf("[DEBUG] Interned new string.   Current count: %d. String: \"%s\"\n", strings.count, string->data);
     return string;
 }
+
+void interned_strings_remove_unmarked() {
+    for (int i = 0; i < strings.capacity; ++i) {
+        String* entry = strings.entries[i];
+        if (entry != NULL && entry != TOMBSTONE && !entry->obj.marked && !entry->obj.pinned) {
+            strings.entries[i] = TOMBSTONE;
+        }
+    }
+}
@@ -3,9 +3,13 @@
 #include <string.h>
 #include "environment.h"
 #include "hash.h"
+#include "map.h"
+#include "memory.h"
 #include "strings.h"
 #include "value.h"
 
+#define ROPE_MIN_LENGTH 64  // shorter concatenations are copied instead of linked
+
 const char* value_type_as_cstr(ValueType type) {
     switch (type) {
         case VALUE_NULL:     return "null";
@@ -14,6 +18,7 @@ const char* value_type_as_cstr(ValueType type) {
         case VALUE_BOOL:     return "bool";
         case VALUE_STRING:   return "string";
         case VALUE_LIST:     return "list";
+        case VALUE_MAP:      return "map";
         case VALUE_NATIVE:   return "native_func";
         case VALUE_FUNCTION: return "function";
         case VALUE_MODULE:   return "module";
@@ -22,70 +27,97 @@ const char* value_type_as_cstr(ValueType type) {
 }
 
 bool values_equal(Value a, Value b) {
-    if (a.type != b.type)    return false;
-    switch (a.type) {
+    if (VALUE_TYPE(a) != VALUE_TYPE(b))    return false;
+    switch (VALUE_TYPE(a)) {
         case VALUE_NULL:     return true;
-        case VALUE_INT:      return a.integer == b.integer;
-        case VALUE_BOOL:     return a.boolean == b.boolean;
-        case VALUE_STRING:   return strings_equal(a.string, b.string);
-        case VALUE_LIST:     return lists_equal(a.list, b.list);
-        case VALUE_NATIVE:   return a.native == b.native;
-        case VALUE_FUNCTION: return strings_equal(a.function->name, b.function->name);
-        case VALUE_MODULE:   return strings_equal(a.module->name, b.module->name);
+        case VALUE_INT:      return AS_INT(a) == AS_INT(b);
+        case VALUE_FLOAT:    return AS_FLOAT(a) == AS_FLOAT(b);
+        case VALUE_BOOL:     return AS_BOOL(a) == AS_BOOL(b);
+        case VALUE_STRING:   return strings_equal(AS_STRING(a), AS_STRING(b));
+        case VALUE_LIST:     return lists_equal(AS_LIST(a), AS_LIST(b));
+        case VALUE_MAP:      return maps_equal(AS_MAP(a), AS_MAP(b));
+        case VALUE_NATIVE:   return AS_NATIVE(a) == AS_NATIVE(b);
+        case VALUE_FUNCTION: return strings_equal(AS_FUNCTION(a)->name, AS_FUNCTION(b)->name);
+        case VALUE_MODULE:   return strings_equal(AS_MODULE(a)->name, AS_MODULE(b)->name);
         default:             return false;
     }
 }
 
+// strings inside of collections are quoted
+static void print_element(Value element) {
+    if (VALUE_TYPE(element) != VALUE_STRING) {
+        print_value(element);
+    }
+    else {
+        putchar('"');
+        print_value(element);
+        putchar('"');
+    }
+}
+
 void print_value(Value value) {
-    switch (value.type) {
+    switch (VALUE_TYPE(value)) {
         case VALUE_NULL: {
             fputs("null", stdout);
         } break;
         case VALUE_INT: {
-            printf("%ld", value.integer);
+            printf("%ld", AS_INT(value));
         } break;
         case VALUE_FLOAT: {
-            printf("%g", value.floating);
+            printf("%g", AS_FLOAT(value));
         } break;
         case VALUE_BOOL: {
-            printf("%s", value.boolean ? "true" : "false");
+            printf("%s", AS_BOOL(value) ? "true" : "false");
         } break;
         case VALUE_STRING: {
-            printf("%s", value.string->data);
+            printf("%s", string_data(AS_STRING(value)));
         } break;
         case VALUE_LIST: {
             fputs("[", stdout);
-            for (int i = 0; i < value.list->length; ++i) {
-                if (value.list->values[i].type != VALUE_STRING) {
-                    print_value(value.list->values[i]);
-                }
-                else {
-                    putchar('"');
-                    print_value(value.list->values[i]);
-                    putchar('"');
-                }
-                if (i < value.list->length - 1) {
+            for (int i = 0; i < AS_LIST(value)->length; ++i) {
+                print_element(list_get(AS_LIST(value), i));
+                if (i < AS_LIST(value)->length - 1) {
                     printf(", ");
                 }
             }
             fputs("]", stdout);
         } break;
+        case VALUE_MAP: {
+            Map* map = AS_MAP(value);
+            fputs("{", stdout);
+            bool first = true;
+            for (int i = map_next(map, 0); i >= 0; i = map_next(map, i + 1)) {
+                if (!first) printf(", ");
+                print_element(map->entries[i].key);
+                printf(": ");
+                print_element(map->entries[i].value);
+                first = false;
+            }
+            fputs("}", stdout);
+        } break;
         case VALUE_NATIVE: {
-            printf("<native>");  // TODO: print proper native function value
+            printf("<native %s>", AS_NATIVE(value)->name->data);
         } break;
         case VALUE_FUNCTION: {
-            printf("<function %s>", value.function->name->data);
+            printf("<function %s>", AS_FUNCTION(value)->name->data);
         } break;
         case VALUE_MODULE: {
-            printf("<module %s>", value.module->name->data);
+            printf("<module %s>", AS_MODULE(value)->name->data);
         }
     }
 }
 
-String* string_create(int length, Hash hash, const char* data) {
-    String* string = calloc(1, sizeof(String) + length + 1);
+static String* string_allocate(int length) {
+    String* string = (String*)gc_allocate(sizeof(String) + length + 1, OBJ_STRING);
     string->length = length;
+    string->data = string->chars;
+    return string;
+}
+
+String* string_create(int length, Hash hash, const char* data) {
+    String* string = string_allocate(length);
     string->hash = hash;
+    string->interned = true;
     memcpy(string->data, data, length);
     return string;
 }
@@ -100,35 +132,192 @@ String* string_from(const char* data) {
 
 String* string_concat(String* a, String* b) {
     int length = a->length + b->length;
-    char* c = malloc(sizeof(char) * length);
-    memcpy(c, a->data, a->length);
-    memcpy(c + a->length, b->data, b->length);
-    String* string = intern_string(c, length);
-    free(c);
+    if (length < ROPE_MIN_LENGTH) {
+        // short strings are cheaper to copy than to link, both halves are flat here
+        String* string = string_allocate(length);
+        memcpy(string->data, a->data, a->length);
+        memcpy(string->data + a->length, b->data, b->length);
+        return string;
+    }
+
+    String* string = (String*)gc_allocate(sizeof(String), OBJ_STRING);
+    string->length = length;
+    string->left = a;
+    string->right = b;
     return string;
 }
 
+// copies leaves of rope into one buffer, going from the last character backwards,
+// without recursion, because ropes built by appending in a loop are very deep
+static void string_flatten(String* string) {
+    char* buffer = malloc(string->length + 1);
+    buffer[string->length] = '\0';
+    int end = string->length;
+
+    String** pending = NULL;
+    int pending_count = 0;
+    int pending_capacity = 0;
+    String* node = string;
+    for (;;) {
+        if (node->data != NULL) {
+            end -= node->length;
+            memcpy(buffer + end, node->data, node->length);
+            if (pending_count == 0) break;
+            node = pending[--pending_count];
+        }
+        else {
+            if (pending_capacity < pending_count + 1) {
+                pending_capacity = GROW_CAPACITY(pending_capacity);
+                pending = GROW_ARRAY(String*, pending, pending_capacity);
+            }
+            pending[pending_count++] = node->left;
+            node = node->right;
+        }
+    }
+    free(pending);
+
+    string->data = buffer;
+    string->left = NULL;
+    string->right = NULL;
+    gc_track(string->length + 1);
+}
+
+char* string_data(String* string) {
+    if (string->data == NULL) {
+        string_flatten(string);
+    }
+    return string->data;
+}
+
+String* string_intern(String* string) {
+    if (string->interned) return string;
+    return intern_string(string_data(string), string->length);
+}
+
 bool strings_equal(String* a, String* b) {
-    return a->hash == b->hash && a->length == b->length && strcmp(a->data, b->data) == 0;
+    if (a == b) return true;
+    if ((a->interned && b->interned) || a->length != b->length) return false;
+    return memcmp(string_data(a), string_data(b), a->length) == 0;
+}
+
+size_t list_element_size(ListKind kind) {
+    return kind == LIST_VALUES ? sizeof(Value) : sizeof(int64_t);
+}
+
+// new lists are packed ints until first element of another type is stored
+List* list_new(int capacity) {
+    List* list = (List*)gc_allocate(sizeof(List), OBJ_LIST);
+    list->kind = LIST_INTS;
+    list->ints = calloc(capacity, sizeof(int64_t));
+    list->length = 0;
+    list->capacity = capacity;
+    gc_track(sizeof(int64_t) * capacity);
+    return list;
 }
 
-List* list_new(int length) {
-    List* list = calloc(1, sizeof(List));
-    list->values = calloc(length, sizeof(Value));
-    list->capacity = length;
+static void list_resize(List* list, ListKind kind, int capacity) {
+    long old_size = list_element_size(list->kind) * list->capacity;
+    long new_size = list_element_size(kind) * capacity;
+    list->ints = reallocate(list->ints, new_size);
+    list->kind = kind;
+    list->capacity = capacity;
+    gc_track(new_size - old_size);
+}
+
+List* list_new_packed(ListKind kind, int length) {
+    List* list = list_new(0);
+    list_resize(list, kind, length);
+    if (length > 0) memset(list->ints, 0, list_element_size(kind) * length);
+    list->length = length;
     return list;
 }
 
+void list_box(List* list) {
+    if (list->kind == LIST_VALUES) return;
+
+    ListKind kind = list->kind;
+    int64_t* ints = list->ints;
+    double* floats = list->floats;
+    Value* values = malloc(sizeof(Value) * list->capacity);
+    for (int i = 0; i < list->length; ++i) {
+        values[i] = kind == LIST_INTS ? INT_VALUE(ints[i]) : FLOAT_VALUE(floats[i]);
+    }
+    free(ints);
+    list->values = values;
+    list->kind = LIST_VALUES;
+    gc_track((long)(sizeof(Value) - sizeof(int64_t)) * list->capacity);
+}
+
+// stores value into list of matching kind, returns false if list has to be boxed first
+static inline bool list_store_packed(List* list, int index, Value value) {
+    switch (list->kind) {
+        case LIST_INTS: {
+            if (!IS_INT(value)) return false;
+            list->ints[index] = AS_INT(value);
+        } return true;
+        case LIST_FLOATS: {
+            if (!IS_FLOAT(value)) return false;
+            list->floats[index] = AS_FLOAT(value);
+        } return true;
+        default: {
+            list->values[index] = value;
+        } return true;
+    }
+}
+
+void list_append(List* list, Value value) {
+    if (list->length == 0 && list->kind != LIST_VALUES) {
+        // empty list takes kind of its first element
+        ListKind kind = IS_INT(value) ? LIST_INTS : IS_FLOAT(value) ? LIST_FLOATS : LIST_VALUES;
+        if (kind != list->kind) list_resize(list, kind, list->capacity);
+    }
+    if (list->capacity < list->length + 1) {
+        list_resize(list, list->kind, GROW_CAPACITY(list->capacity));
+    }
+    if (!list_store_packed(list, list->length, value)) {
+        list_box(list);
+        list->values[list->length] = value;
+    }
+    ++list->length;
+}
+
+void list_set(List* list, int index, Value value) {
+    if (!list_store_packed(list, index, value)) {
+        list_box(list);
+        list->values[index] = value;
+    }
+}
+
 bool lists_equal(List* a, List* b) {
     if (a->length != b->length) return false;
     for (int i = 0; i < a->length; ++i) {
-        if (!values_equal(a->values[i], b->values[i])) return false;
+        if (!values_equal(list_get(a, i), list_get(b, i))) return false;
     }
     return true;
 }
 
+Native* native_new(String* name, NativeFn function, int min_arity, int max_arity) {
+    Native* native = (Native*)gc_allocate(sizeof(Native), OBJ_NATIVE);
+    native->name = name;
+    native->function = function;
+    native->min_arity = min_arity;
+    native->max_arity = max_arity;
+    return native;
+}
+
+Function* function_new(String* name, String** params, int param_count, struct ASTNode* body) {
+    Function* function = (Function*)gc_allocate(sizeof(Function), OBJ_FUNCTION);
+    function->name = name;
+    function->params = params;
+    function->param_count = param_count;
+    function->body = body;
+    function->chunk = NULL;
+    function->globals = NULL;
+    return function;
+}
+
 Module* module_new(String* name, Environment* env) {
-    Module* module = malloc(sizeof(Module));
+    Module* module = (Module*)gc_allocate(sizeof(Module), OBJ_MODULE);
     module->name = name;
     module->env = env;
     return module;
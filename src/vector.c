@@ -0,0 +1,169 @@
+#include "value.h"
+#include "vector.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// int kernels check every step as operator_ints() does, so packed lists fail where boxed ones would;
+// SSE2 can't detect 64-bit overflow, so they are scalar
+bool vector_sum_ints(const int64_t* a, int count, int64_t* sum) {
+    *sum = 0;
+    for (int i = 0; i < count; ++i) {
+        if (__builtin_add_overflow(*sum, a[i], sum) || !int_fits(*sum)) return false;
+    }
+    return true;
+}
+
+double vector_sum_floats(const double* a, int count) {
+    double sum = 0.0;
+    int i = 0;
+#ifdef __SSE2__
+    __m128d sum0 = _mm_setzero_pd();
+    __m128d sum1 = _mm_setzero_pd();
+    for (; i + 4 <= count; i += 4) {
+        sum0 = _mm_add_pd(sum0, _mm_loadu_pd(a + i));
+        sum1 = _mm_add_pd(sum1, _mm_loadu_pd(a + i + 2));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(sum0, sum1));
+    sum = lanes[0] + lanes[1];
+#endif
+    for (; i < count; ++i) {
+        sum += a[i];
+    }
+    return sum;
+}
+
+// SSE2 has no 64-bit integer comparison
+int64_t vector_min_ints(const int64_t* a, int count) {
+    int64_t min = a[0];
+    for (int i = 1; i < count; ++i) {
+        if (a[i] < min) min = a[i];
+    }
+    return min;
+}
+
+int64_t vector_max_ints(const int64_t* a, int count) {
+    int64_t max = a[0];
+    for (int i = 1; i < count; ++i) {
+        if (a[i] > max) max = a[i];
+    }
+    return max;
+}
+
+double vector_min_floats(const double* a, int count) {
+    double min = a[0];
+    int i = 1;
+#ifdef __SSE2__
+    if (count >= 2) {
+        __m128d lanes_min = _mm_loadu_pd(a);
+        for (i = 2; i + 2 <= count; i += 2) {
+            lanes_min = _mm_min_pd(lanes_min, _mm_loadu_pd(a + i));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, lanes_min);
+        min = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+    }
+#endif
+    for (; i < count; ++i) {
+        if (a[i] < min) min = a[i];
+    }
+    return min;
+}
+
+double vector_max_floats(const double* a, int count) {
+    double max = a[0];
+    int i = 1;
+#ifdef __SSE2__
+    if (count >= 2) {
+        __m128d lanes_max = _mm_loadu_pd(a);
+        for (i = 2; i + 2 <= count; i += 2) {
+            lanes_max = _mm_max_pd(lanes_max, _mm_loadu_pd(a + i));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, lanes_max);
+        max = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+    }
+#endif
+    for (; i < count; ++i) {
+        if (a[i] > max) max = a[i];
+    }
+    return max;
+}
+
+bool vector_dot_ints(const int64_t* a, const int64_t* b, int count, int64_t* sum) {
+    *sum = 0;
+    for (int i = 0; i < count; ++i) {
+        int64_t product;
+        if (__builtin_mul_overflow(a[i], b[i], &product) || !int_fits(product)) return false;
+        if (__builtin_add_overflow(*sum, product, sum) || !int_fits(*sum)) return false;
+    }
+    return true;
+}
+
+double vector_dot_floats(const double* a, const double* b, int count) {
+    double sum = 0.0;
+    int i = 0;
+#ifdef __SSE2__
+    __m128d sum0 = _mm_setzero_pd();
+    __m128d sum1 = _mm_setzero_pd();
+    for (; i + 4 <= count; i += 4) {
+        sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(sum0, sum1));
+    sum = lanes[0] + lanes[1];
+#endif
+    for (; i < count; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+int vector_op_ints(TokenType op, int64_t* out, const int64_t* a, const int64_t* b, int b_step, int count) {
+    for (int i = 0; i < count; ++i) {
+        int64_t right = b[i * b_step];
+        bool failed;
+        switch (op) {
+            case TOKEN_PLUS:     failed = __builtin_add_overflow(a[i], right, &out[i]); break;
+            case TOKEN_MINUS:    failed = __builtin_sub_overflow(a[i], right, &out[i]); break;
+            case TOKEN_ASTERISK: failed = __builtin_mul_overflow(a[i], right, &out[i]); break;
+            default: {
+                failed = right == 0 || (right == -1 && a[i] == INT_VALUE_MIN);
+                if (!failed) out[i] = a[i] / right;
+            } break;
+        }
+        if (failed || !int_fits(out[i])) return i;
+    }
+    return -1;
+}
+
+void vector_op_floats(TokenType op, double* out, const double* a, const double* b, int b_step, int count) {
+    int i = 0;
+#ifdef __SSE2__
+    __m128d scalar = _mm_set1_pd(b[0]);
+    for (; i + 2 <= count; i += 2) {
+        __m128d right = b_step == 0 ? scalar : _mm_loadu_pd(b + i);
+        __m128d left = _mm_loadu_pd(a + i);
+        __m128d result;
+        switch (op) {
+            case TOKEN_PLUS:     result = _mm_add_pd(left, right); break;
+            case TOKEN_MINUS:    result = _mm_sub_pd(left, right); break;
+            case TOKEN_ASTERISK: result = _mm_mul_pd(left, right); break;
+            default:             result = _mm_div_pd(left, right); break;
+        }
+        _mm_storeu_pd(out + i, result);
+    }
+#endif
+    for (; i < count; ++i) {
+        double right = b[i * b_step];
+        switch (op) {
+            case TOKEN_PLUS:     out[i] = a[i] + right; break;
+            case TOKEN_MINUS:    out[i] = a[i] - right; break;
+            case TOKEN_ASTERISK: out[i] = a[i] * right; break;
+            default:             out[i] = a[i] / right; break;
+        }
+    }
+}
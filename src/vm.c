@@ -0,0 +1,523 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "astcache.h"
+#include "chunk.h"
+#include "compiler.h"
+#include "environment.h"
+#include "error.h"
+#include "io.h"
+#include "map.h"
+#include "memory.h"
+#include "natives.h"
+#include "operators.h"
+#include "parser.h"
+#include "profiler.h"
+#include "strings.h"
+#include "value.h"
+#include "vm.h"
+
+#define FRAMES_MAX 1024
+#define FRAME_SLOTS 256
+#define STACK_MAX (FRAMES_MAX * FRAME_SLOTS)
+
+typedef struct {
+    Function* function;
+    uint8_t* ip;
+    Value* slots;
+} CallFrame;
+
+typedef struct {
+    CallFrame frames[FRAMES_MAX];
+    int frame_count;
+
+    Value stack[STACK_MAX];
+    Value* stack_top;
+
+    Environment* natives;
+    HashMap modules;  // canonical path of imported file -> module
+} VM;
+
+static VM vm;
+
+// imported modules are parsed here, compiled functions still point to their bodies
+static Arena modules_arena;
+
+inline static void push(Value value) {
+    if (vm.stack_top == vm.stack + STACK_MAX) {
+        runtime_error("stack overflow");
+    }
+    *vm.stack_top++ = value;
+}
+
+inline static Value pop() {
+    return *--vm.stack_top;
+}
+
+inline static Value peek(int distance) {
+    return vm.stack_top[-1 - distance];
+}
+
+static void call_function(Function* function, int argc) {
+    if (function->param_count != argc) {
+        runtime_error("expected %d arguments, but got %d", function->param_count, argc);
+    }
+    if (vm.frame_count == FRAMES_MAX) {
+        runtime_error("stack overflow");
+    }
+    CallFrame* frame = &vm.frames[vm.frame_count++];
+    frame->function = function;
+    frame->ip = function->chunk->code;
+    frame->slots = vm.stack_top - argc - 1;
+}
+
+// replaces callee and arguments with result
+static void call_native(Native* native, int argc) {
+    natives_check_arity(native, argc);
+    Value result = native->function(argc, vm.stack_top - argc);
+    vm.stack_top -= argc + 1;
+    push(result);
+}
+
+static void run(int base_frame);
+
+// each file is parsed and run only on its first import, later imports share its module
+static Value import_module(String* path, String* name) {
+    char* canonical_path = file_canonical_path(path->data);
+    String* key = intern_string(canonical_path, strlen(canonical_path));
+    free(canonical_path);
+
+    Value* cached = hashmap_get_ref(&vm.modules, key);
+    if (cached != NULL) {
+        return *cached;
+    }
+
+    push(STRING_VALUE(key));
+    ASTNode* imported_ast = NULL;
+    if (!astcache_parse_file(path->data, &modules_arena, &imported_ast)) {
+        runtime_error("there were errors during parsing imported module `%s`", path->data);
+    }
+    Function* script = compiler_compile(imported_ast);
+    if (script == NULL) {
+        runtime_error("there were errors during compiling imported module `%s`", path->data);
+    }
+
+    // module is registered before its code runs, so circular imports get the partially initialized one
+    push(FUNCTION_VALUE(script));
+    script->globals = env_new_sized(vm.natives, ((ASTNodeBlock*)imported_ast)->local_count);
+    Value module = MODULE_VALUE(module_new(name, script->globals));
+    hashmap_put(&vm.modules, key, module);
+    vm.stack_top[-2] = FUNCTION_VALUE(script);
+    pop();
+
+    call_function(script, 0);
+    run(vm.frame_count - 1);
+    pop();
+    return module;
+}
+
+static void run(int base_frame) {
+    CallFrame* frame = &vm.frames[vm.frame_count - 1];
+    uint8_t* ip = frame->ip;
+    Value* constants = frame->function->chunk->constants;
+
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+#define READ_CONSTANT() (constants[READ_SHORT()])
+#define READ_STRING() (AS_STRING(READ_CONSTANT()))
+#define READ_CACHE() (&frame->function->chunk->caches[READ_SHORT()])
+#define SYNC_LINE() (current_line = frame->function->chunk->lines[(int)(ip - frame->function->chunk->code) - 1])
+// generic is operator_binary() or operator_compound(), called when fast paths don't apply
+#define BINARY_OP(token, generic) \
+    do { \
+        Value right = peek(0); \
+        Value left = peek(1); \
+        Value* result = &vm.stack_top[-2]; \
+        if (!(IS_INT(left) && IS_INT(right) && operator_ints(token, AS_INT(left), AS_INT(right), result)) && \
+            !(IS_FLOAT(left) && IS_FLOAT(right) && operator_floats(token, AS_FLOAT(left), AS_FLOAT(right), result))) { \
+            SYNC_LINE(); \
+            *result = generic(token, left, right); \
+        } \
+        --vm.stack_top; \
+    } while (false)
+
+#ifdef COMPUTED_GOTO
+    // each handler jumps straight to the next one, so every jump has its own branch history;
+    // compiler emits only known instructions, so opcodes without entry are never dispatched
+    static void* handlers[] = {
+        [OP_CONSTANT]      = &&handle_OP_CONSTANT,
+        [OP_NULL]          = &&handle_OP_NULL,
+        [OP_TRUE]          = &&handle_OP_TRUE,
+        [OP_FALSE]         = &&handle_OP_FALSE,
+        [OP_POP]           = &&handle_OP_POP,
+        [OP_DUP2]          = &&handle_OP_DUP2,
+        [OP_GET_LOCAL]     = &&handle_OP_GET_LOCAL,
+        [OP_SET_LOCAL]     = &&handle_OP_SET_LOCAL,
+        [OP_GET_GLOBAL]    = &&handle_OP_GET_GLOBAL,
+        [OP_SET_GLOBAL]    = &&handle_OP_SET_GLOBAL,
+        [OP_DEFINE_GLOBAL] = &&handle_OP_DEFINE_GLOBAL,
+        [OP_GET_PROPERTY]  = &&handle_OP_GET_PROPERTY,
+        [OP_GET_INDEX]     = &&handle_OP_GET_INDEX,
+        [OP_SET_INDEX]     = &&handle_OP_SET_INDEX,
+        [OP_EQUAL]         = &&handle_OP_EQUAL,
+        [OP_NOT_EQUAL]     = &&handle_OP_NOT_EQUAL,
+        [OP_GREATER]       = &&handle_OP_GREATER,
+        [OP_GREATER_EQUAL] = &&handle_OP_GREATER_EQUAL,
+        [OP_LESS]          = &&handle_OP_LESS,
+        [OP_LESS_EQUAL]    = &&handle_OP_LESS_EQUAL,
+        [OP_ADD]           = &&handle_OP_ADD,
+        [OP_SUBTRACT]      = &&handle_OP_SUBTRACT,
+        [OP_MULTIPLY]      = &&handle_OP_MULTIPLY,
+        [OP_DIVIDE]        = &&handle_OP_DIVIDE,
+        [OP_MODULO]        = &&handle_OP_MODULO,
+        [OP_COMPOUND]      = &&handle_OP_COMPOUND,
+        [OP_NOT]           = &&handle_OP_NOT,
+        [OP_NEGATE]        = &&handle_OP_NEGATE,
+        [OP_JUMP]          = &&handle_OP_JUMP,
+        [OP_JUMP_IF_FALSE] = &&handle_OP_JUMP_IF_FALSE,
+        [OP_LOOP]          = &&handle_OP_LOOP,
+        [OP_RANGE]         = &&handle_OP_RANGE,
+        [OP_ITERATOR]      = &&handle_OP_ITERATOR,
+        [OP_FOR_IN]        = &&handle_OP_FOR_IN,
+        [OP_CALL]          = &&handle_OP_CALL,
+        [OP_TAIL_CALL]     = &&handle_OP_TAIL_CALL,
+        [OP_RETURN]        = &&handle_OP_RETURN,
+        [OP_LIST]          = &&handle_OP_LIST,
+        [OP_LIST_APPEND]   = &&handle_OP_LIST_APPEND,
+        [OP_MAP]           = &&handle_OP_MAP,
+        [OP_MAP_INSERT]    = &&handle_OP_MAP_INSERT,
+        [OP_FUNCTION]      = &&handle_OP_FUNCTION,
+        [OP_IMPORT]        = &&handle_OP_IMPORT,
+    };
+#define HANDLER(op) handle_##op
+#define NEXT() goto *handlers[READ_BYTE()]
+    NEXT();
+    {
+#else
+#define HANDLER(op) case op
+#define NEXT() break
+    for (;;) switch (READ_BYTE()) {
+#endif
+        HANDLER(OP_CONSTANT): push(READ_CONSTANT()); NEXT();
+        HANDLER(OP_NULL):     push(NULL_VALUE()); NEXT();
+        HANDLER(OP_TRUE):     push(BOOL_VALUE(true)); NEXT();
+        HANDLER(OP_FALSE):    push(BOOL_VALUE(false)); NEXT();
+        HANDLER(OP_POP):      pop(); NEXT();
+        HANDLER(OP_DUP2): {
+            push(peek(1));
+            push(peek(1));
+        } NEXT();
+        HANDLER(OP_GET_LOCAL): {
+            uint8_t slot = READ_BYTE();
+            push(frame->slots[slot]);
+        } NEXT();
+        HANDLER(OP_SET_LOCAL): {
+            uint8_t slot = READ_BYTE();
+            frame->slots[slot] = peek(0);
+        } NEXT();
+        HANDLER(OP_GET_GLOBAL): {
+            String* name = READ_STRING();
+            Value* value = env_get_cached(frame->function->globals, name, READ_CACHE());
+            if (value == NULL) {
+                SYNC_LINE();
+                runtime_error("undeclared identifier '%s'", name->data);
+            }
+            push(*value);
+        } NEXT();
+        HANDLER(OP_SET_GLOBAL): {
+            String* name = READ_STRING();
+            Value* value = env_get_cached(frame->function->globals, name, READ_CACHE());
+            if (value == NULL) {
+                SYNC_LINE();
+                runtime_error("undeclared identifier '%s'", name->data);
+            }
+            *value = peek(0);
+        } NEXT();
+        HANDLER(OP_DEFINE_GLOBAL): {
+            String* name = READ_STRING();
+            if (env_define(frame->function->globals, name, peek(0))) {
+                SYNC_LINE();
+                runtime_error("redeclaration of variable '%s'", name->data);
+            }
+            pop();
+        } NEXT();
+        HANDLER(OP_GET_PROPERTY): {
+            String* name = READ_STRING();
+            EnvCache* cache = READ_CACHE();
+            Value object = peek(0);
+            if (!IS_MODULE(object)) {
+                SYNC_LINE();
+                runtime_error("Object of type '%s' doesn't have properties", value_type_as_cstr(VALUE_TYPE(object)));
+            }
+            Value* value = env_get_cached(AS_MODULE(object)->env, name, cache);
+            if (value == NULL) {
+                SYNC_LINE();
+                runtime_error("module '%s' has no member '%s'", AS_MODULE(object)->name->data, name->data);
+            }
+            vm.stack_top[-1] = *value;
+        } NEXT();
+        HANDLER(OP_GET_INDEX): {
+            SYNC_LINE();
+            Value value = operator_subscript_get(peek(1), peek(0));
+            vm.stack_top -= 2;
+            push(value);
+        } NEXT();
+        HANDLER(OP_SET_INDEX): {
+            SYNC_LINE();
+            Value value = peek(0);
+            operator_subscript_set(peek(2), peek(1), value);
+            vm.stack_top -= 3;
+            push(value);
+        } NEXT();
+        HANDLER(OP_EQUAL): {
+            Value right = pop();
+            Value left = pop();
+            push(BOOL_VALUE(values_equal(left, right)));
+        } NEXT();
+        HANDLER(OP_NOT_EQUAL): {
+            Value right = pop();
+            Value left = pop();
+            push(BOOL_VALUE(!values_equal(left, right)));
+        } NEXT();
+        HANDLER(OP_GREATER):       BINARY_OP(TOKEN_GREATER, operator_binary); NEXT();
+        HANDLER(OP_GREATER_EQUAL): BINARY_OP(TOKEN_GREATER_EQUAL, operator_binary); NEXT();
+        HANDLER(OP_LESS):          BINARY_OP(TOKEN_LESS, operator_binary); NEXT();
+        HANDLER(OP_LESS_EQUAL):    BINARY_OP(TOKEN_LESS_EQUAL, operator_binary); NEXT();
+        HANDLER(OP_ADD):           BINARY_OP(TOKEN_PLUS, operator_binary); NEXT();
+        HANDLER(OP_SUBTRACT):      BINARY_OP(TOKEN_MINUS, operator_binary); NEXT();
+        HANDLER(OP_MULTIPLY):      BINARY_OP(TOKEN_ASTERISK, operator_binary); NEXT();
+        HANDLER(OP_DIVIDE):        BINARY_OP(TOKEN_SLASH, operator_binary); NEXT();
+        HANDLER(OP_MODULO):        BINARY_OP(TOKEN_PERCENT, operator_binary); NEXT();
+        HANDLER(OP_COMPOUND): {
+            TokenType op = (TokenType)READ_BYTE();
+            BINARY_OP(op, operator_compound);
+        } NEXT();
+        HANDLER(OP_NOT): {
+            vm.stack_top[-1] = BOOL_VALUE(!is_truthy(peek(0)));
+        } NEXT();
+        HANDLER(OP_NEGATE): {
+            Value value = peek(0);
+            if (IS_INT(value) && AS_INT(value) != INT_VALUE_MIN) {
+                vm.stack_top[-1] = INT_VALUE(-AS_INT(value));
+            }
+            else {
+                SYNC_LINE();
+                vm.stack_top[-1] = operator_unary(TOKEN_MINUS, value);
+            }
+        } NEXT();
+        HANDLER(OP_JUMP): {
+            uint16_t offset = READ_SHORT();
+            ip += offset;
+        } NEXT();
+        HANDLER(OP_JUMP_IF_FALSE): {
+            uint16_t offset = READ_SHORT();
+            if (!is_truthy(peek(0))) ip += offset;
+        } NEXT();
+        HANDLER(OP_LOOP): {
+            uint16_t offset = READ_SHORT();
+            ip -= offset;
+            if (profiler_ticks) {
+                SYNC_LINE();
+                profiler_sample();
+            }
+        } NEXT();
+        HANDLER(OP_RANGE): {
+            int argc = READ_BYTE();
+            if (natives_is_range(peek(argc))) {
+                SYNC_LINE();
+                int64_t start, step;
+                natives_check_arity(AS_NATIVE(peek(argc)), argc);
+                int64_t count = natives_range_arguments(argc, vm.stack_top - argc, &start, &step);
+                vm.stack_top -= argc + 1;
+                push(INT_VALUE(count));
+                push(INT_VALUE(start));
+                push(INT_VALUE(step));
+                ip += 3;  // OP_CALL and OP_ITERATOR
+            }
+        } NEXT();
+        HANDLER(OP_ITERATOR): {
+            Value iterable = peek(0);
+            if (!IS_LIST(iterable) && !IS_MAP(iterable)) {
+                SYNC_LINE();
+                runtime_error("object of type '%s' is not iterable", value_type_as_cstr(VALUE_TYPE(iterable)));
+            }
+            push(INT_VALUE(0));
+            push(NULL_VALUE());
+        } NEXT();
+        HANDLER(OP_FOR_IN): {
+            Value* state = &frame->slots[READ_BYTE()];
+            uint16_t offset = READ_SHORT();
+            if (IS_LIST(state[0])) {
+                // list may have been changed by loop body
+                int64_t index = AS_INT(state[1]);
+                if (index < AS_LIST(state[0])->length) {
+                    state[3] = list_get(AS_LIST(state[0]), (int)index);
+                    state[1] = INT_VALUE(index + 1);
+                }
+                else {
+                    ip += offset;
+                }
+            }
+            else if (IS_MAP(state[0])) {
+                // keys inserted while iterating may be skipped, if map grows they may repeat
+                int index = map_next(AS_MAP(state[0]), (int)AS_INT(state[1]));
+                if (index >= 0) {
+                    state[3] = AS_MAP(state[0])->entries[index].key;
+                    state[1] = INT_VALUE(index + 1);
+                }
+                else {
+                    ip += offset;
+                }
+            }
+            else if (AS_INT(state[0]) > 0) {
+                state[3] = state[1];
+                state[1] = INT_VALUE((int64_t)((uint64_t)AS_INT(state[1]) + (uint64_t)AS_INT(state[2])));
+                state[0] = INT_VALUE(AS_INT(state[0]) - 1);
+            }
+            else {
+                ip += offset;
+            }
+        } NEXT();
+        HANDLER(OP_CALL): {
+            int argc = READ_BYTE();
+            Value callee = peek(argc);
+            SYNC_LINE();
+            PROFILER_POLL();
+            if (IS_NATIVE(callee)) {
+                call_native(AS_NATIVE(callee), argc);
+            }
+            else if (IS_FUNCTION(callee)) {
+                frame->ip = ip;
+                call_function(AS_FUNCTION(callee), argc);
+                PROFILER_ENTER(AS_FUNCTION(callee));
+                frame = &vm.frames[vm.frame_count - 1];
+                ip = frame->ip;
+                constants = frame->function->chunk->constants;
+            }
+            else {
+                runtime_error("attempt to call a non-function value");
+            }
+        } NEXT();
+        HANDLER(OP_TAIL_CALL): {
+            int argc = READ_BYTE();
+            Value callee = peek(argc);
+            SYNC_LINE();
+            PROFILER_POLL();
+            if (IS_NATIVE(callee)) {
+                call_native(AS_NATIVE(callee), argc);  // result is returned by following OP_RETURN
+            }
+            else if (IS_FUNCTION(callee)) {
+                Function* function = AS_FUNCTION(callee);
+                if (function->param_count != argc) {
+                    runtime_error("expected %d arguments, but got %d", function->param_count, argc);
+                }
+                // callee and arguments replace slots of returning function, whose frame is reused
+                memmove(frame->slots, vm.stack_top - argc - 1, sizeof(Value) * (argc + 1));
+                vm.stack_top = frame->slots + argc + 1;
+                frame->function = function;
+                ip = function->chunk->code;
+                constants = function->chunk->constants;
+                PROFILER_LEAVE();
+                PROFILER_ENTER(function);
+            }
+            else {
+                runtime_error("attempt to call a non-function value");
+            }
+        } NEXT();
+        HANDLER(OP_RETURN): {
+            Value result = pop();
+            vm.stack_top = frame->slots;
+            --vm.frame_count;
+            push(result);
+            if (vm.frame_count == base_frame) {
+                return;
+            }
+            PROFILER_LEAVE();  // scripts of program and modules are not on profiler stack
+            frame = &vm.frames[vm.frame_count - 1];
+            ip = frame->ip;
+            constants = frame->function->chunk->constants;
+        } NEXT();
+        HANDLER(OP_LIST): {
+            uint16_t capacity = READ_SHORT();
+            push(LIST_VALUE(list_new(capacity)));
+        } NEXT();
+        HANDLER(OP_LIST_APPEND): {
+            Value value = pop();
+            list_append(AS_LIST(peek(0)), value);
+        } NEXT();
+        HANDLER(OP_MAP): {
+            uint16_t capacity = READ_SHORT();
+            push(MAP_VALUE(map_new(capacity)));
+        } NEXT();
+        HANDLER(OP_MAP_INSERT): {
+            SYNC_LINE();
+            map_set(AS_MAP(peek(2)), map_key(peek(1)), peek(0));
+            vm.stack_top -= 2;
+        } NEXT();
+        HANDLER(OP_FUNCTION): {
+            Function* function = AS_FUNCTION(READ_CONSTANT());
+            function->globals = frame->function->globals;
+            env_define(frame->function->globals, function->name, FUNCTION_VALUE(function));
+        } NEXT();
+        HANDLER(OP_IMPORT): {
+            String* path = READ_STRING();
+            String* name = READ_STRING();
+            SYNC_LINE();
+            frame->ip = ip;
+            push(import_module(path, name));
+        } NEXT();
+#ifndef COMPUTED_GOTO
+        default: {
+            SYNC_LINE();
+            runtime_error("unknown instruction %d", ip[-1]);
+        } break;
+#endif
+    }
+
+#undef READ_BYTE
+#undef READ_SHORT
+#undef READ_CONSTANT
+#undef READ_STRING
+#undef READ_CACHE
+#undef SYNC_LINE
+#undef BINARY_OP
+#undef HANDLER
+#undef NEXT
+}
+
+Value vm_interpret(ASTNode* root) {
+    Function* script = compiler_compile(root);
+    if (script == NULL) {
+        exit(1);
+    }
+
+    vm.stack_top = vm.stack;
+    vm.frame_count = 0;
+    arena_init(&modules_arena);
+    vm.modules = hashmap_create();
+    vm.natives = env_new();
+    natives_define(vm.natives);
+
+    script->globals = env_new_sized(vm.natives, ((ASTNodeBlock*)root)->local_count);
+    push(FUNCTION_VALUE(script));
+    call_function(script, 0);
+    run(0);
+
+    hashmap_free(&vm.modules);
+    arena_free(&modules_arena);
+    return pop();
+}
+
+void vm_mark_roots() {
+    if (vm.stack_top == NULL) return;  // vm was never started
+
+    for (Value* slot = vm.stack; slot < vm.stack_top; ++slot) {
+        gc_mark_value(*slot);
+    }
+    for (int i = 0; i < vm.frame_count; ++i) {
+        gc_mark_object((Obj*)vm.frames[i].function);
+    }
+    gc_mark_object((Obj*)vm.natives);
+    gc_mark_hashmap(&vm.modules);
+}
@@ -0,0 +1,51 @@
+#!/usr/bin/env bash
+# Corrupts every byte of cached tests/astcache.pud in turn and checks that
+# each run still prints the same as a clean parse, as corrupted cache must be
+# treated as a miss.
+#
+# usage: tests/astcache_corrupt.sh [pudel binary]
+
+set -uo pipefail
+
+tests_dir=$(cd "$(dirname "$0")" && pwd)
+pudel=$(cd "$(dirname "${1:-$tests_dir/../pudel}")" && pwd)/$(basename "${1:-pudel}")
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+mkdir "$work/modules"
+cp "$tests_dir/astcache.pud" "$work/"
+cp "$tests_dir/modules/greet.pud" "$work/modules/"
+cd "$work"
+
+run() {
+    timeout 10 "$pudel" "$@" astcache.pud 2>&1 | sed '1,/^-\{64\}$/d'
+}
+
+expected=$(run --no-cache)
+run > /dev/null
+if [ ! -f astcache.pudc ]; then
+    echo "astcache.pud was not cached"
+    exit 1
+fi
+cp astcache.pudc valid.pudc
+
+failed=0
+size=$(stat -c %s valid.pudc)
+for ((offset = 0; offset < size; ++offset)); do
+    cp valid.pudc astcache.pudc
+    byte=$(od -An -tu1 -j "$offset" -N1 valid.pudc)
+    printf "$(printf '\\%03o' $(((byte + 1 + offset % 255) % 256)))" | dd of=astcache.pudc bs=1 seek="$offset" conv=notrunc status=none
+    for mode in tree vm; do
+        flags=()
+        if [ "$mode" = vm ]; then
+            flags+=(--vm)
+        fi
+        actual=$(run "${flags[@]}")
+        if [ "$actual" != "$expected" ]; then
+            echo "corrupting byte $offset of cache changed output ($mode):"
+            echo "$actual" | head -5
+            failed=1
+        fi
+    done
+done
+exit "$failed"
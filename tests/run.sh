@@ -0,0 +1,53 @@
+#!/usr/bin/env bash
+# Runs every tests/*.pud with both interpreters and compares what it prints,
+# program output followed by any error, with tests/<name>.out. Tests in
+# tests/nan_boxing/ are run too when NAN_BOXING=1, those in tests/int64/
+# otherwise. Every tests/*.sh is run with path of pudel binary and must succeed.
+#
+# usage: tests/run.sh [pudel binary]
+
+set -uo pipefail
+
+tests_dir=$(cd "$(dirname "$0")" && pwd)
+pudel=$(cd "$(dirname "${1:-$tests_dir/../pudel}")" && pwd)/$(basename "${1:-pudel}")
+errors=$(mktemp)
+trap 'rm -f "$errors"' EXIT
+
+cd "$tests_dir"
+
+files=(*.pud)
+if [ "${NAN_BOXING:-}" = 1 ]; then
+    files+=(nan_boxing/*.pud)
+else
+    files+=(int64/*.pud)
+fi
+
+failed=0
+for file in "${files[@]}"; do
+    for mode in tree vm; do
+        flags=(--no-cache)
+        if [ "$mode" = vm ]; then
+            flags+=(--vm)
+        fi
+
+        # AST dump printed before the separator line is not part of output
+        actual=$("$pudel" "${flags[@]}" "$file" 2>"$errors" < /dev/null | sed '1,/^-\{64\}$/d'; cat "$errors")
+        if [ "$actual" != "$(cat "${file%.pud}.out")" ]; then
+            echo "FAIL $file ($mode)"
+            diff <(echo "$actual") "${file%.pud}.out" | head -10
+            failed=1
+        fi
+    done
+done
+
+for script in *.sh; do
+    if [ "$script" != run.sh ] && ! "./$script" "$pudel"; then
+        echo "FAIL $script"
+        failed=1
+    fi
+done
+
+if [ "$failed" = 0 ]; then
+    echo "all tests passed"
+fi
+exit "$failed"